@@ -0,0 +1,963 @@
+/*
+ * blib microbenchmarks.
+ *
+ * blib.c is included directly so the benchmarks can count allocations
+ * and set up the renderer without a window or an OpenGL context.
+ *
+ * Usage: blib_bench [--max-n N] [--filter NAME] [--out FILE]
+ * The results are written as CSV (stdout by default):
+ *   benchmark,key,n,ops,ns_per_op,allocs_per_op
+ * */
+
+#define _POSIX_C_SOURCE 199309L
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/*
+ * Allocation counting
+ */
+
+static struct {
+  unsigned long long allocs;
+  unsigned long long bytes;
+} bench_alloc;
+
+static void *
+bench_malloc(size_t size) {
+  bench_alloc.allocs++;
+  bench_alloc.bytes += size;
+  return malloc(size);
+}
+
+static void *
+bench_realloc(void *ptr, size_t size) {
+  bench_alloc.allocs++;
+  bench_alloc.bytes += size;
+  return realloc(ptr, size);
+}
+
+#define malloc(SIZE)       bench_malloc(SIZE)
+#define realloc(PTR, SIZE) bench_realloc(PTR, SIZE)
+#define main blib_main
+#include "../src/blib.c"
+#undef main
+#undef malloc
+#undef realloc
+
+/*
+ * The game callbacks blib.c expects. The benchmark never opens a window.
+ */
+
+void __conf(blib_config *config) { (void)config; }
+void __init(void) {}
+void __loop(f32 dt) { (void)dt; }
+void __tick(f32 dt) { (void)dt; }
+void __draw(batch *batch) { (void)batch; }
+void __quit(void) {}
+
+/*
+ * Harness
+ */
+
+static struct {
+  FILE *out;
+  ccstr filter;
+  u32   max_n;
+  f64   start;
+  u64   start_allocs;
+  u64   sink;
+} bench;
+
+static f64
+bench_now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static b8
+bench_enabled(ccstr name) {
+  return !bench.filter || strstr(name, bench.filter);
+}
+
+static void
+bench_begin(void) {
+  bench.start_allocs = bench_alloc.allocs;
+  bench.start        = bench_now();
+}
+
+static void
+bench_end(ccstr name, ccstr key, u32 n, u64 ops) {
+  f64 elapsed = bench_now() - bench.start;
+  u64 allocs  = bench_alloc.allocs - bench.start_allocs;
+  if (!ops) ops = 1;
+  fprintf(bench.out, "%s,%s,%u,%lu,%.2f,%.4f\n", name, key, n, (unsigned long)ops,
+      elapsed / ops, (f64)allocs / ops);
+  fflush(bench.out);
+}
+
+static u64
+bench_mix(u64 x) {
+  x += UINT64_C(0x9e3779b97f4a7c15);
+  x = (x ^ (x >> 30)) * UINT64_C(0xbf58476d1ce4e5b9);
+  x = (x ^ (x >> 27)) * UINT64_C(0x94d049bb133111eb);
+  return x ^ (x >> 31);
+}
+
+/*
+ * String
+ */
+
+static void
+bench_string(void) {
+  const u32 n = 100000;
+  if (bench_enabled("string_create")) {
+    bench_begin();
+    for (u32 i = 0; i < n; i++) {
+      str s = string_create(STR("position"));
+      bench.sink += s.size;
+      string_destroy(s);
+    }
+    bench_end("string_create", "short", n, n);
+  }
+  if (bench_enabled("string_concat")) {
+    str s = string_create(STR_0);
+    bench_begin();
+    for (u32 i = 0; i < n; i++) {
+      string_concat(&s, STR("a"));
+    }
+    bench_end("string_concat", "1 byte", n, n);
+    string_destroy(s);
+  }
+  if (bench_enabled("string_insert")) {
+    const u32 m = 10000;
+    str s = string_create(STR("ab"));
+    bench_begin();
+    for (u32 i = 0; i < m; i++) {
+      string_insert(&s, STR("c"), s.size / 2);
+    }
+    bench_end("string_insert", "middle", m, m);
+    string_destroy(s);
+  }
+  if (bench_enabled("string_equal")) {
+    str a = string_create(STR("entity_component_position"));
+    str b = string_create(STR("entity_component_position"));
+    bench_begin();
+    for (u32 i = 0; i < n * 10; i++) {
+      bench.sink += string_equal(a, b);
+    }
+    bench_end("string_equal", "25 bytes", n * 10, n * 10);
+    string_destroy(a);
+    string_destroy(b);
+  }
+  if (bench_enabled("string_find_first")) {
+    str s = string_create(STR_0);
+    for (u32 i = 0; i < 4096; i++) string_concat(&s, STR("a"));
+    string_concat(&s, STR("b"));
+    bench_begin();
+    for (u32 i = 0; i < 1000; i++) {
+      bench.sink += (u64)string_find_first(s, 'b');
+    }
+    bench_end("string_find_first", "4 KiB", s.size, 1000);
+    string_destroy(s);
+  }
+  if (bench_enabled("string_find")) {
+    /* a key near the end of a 4 KiB config file */
+    str s = string_create(STR_0);
+    for (u32 i = 0; i < 256; i++) string_concat(&s, STR("key_name = 123\n"));
+    string_concat(&s, STR("window_title = blib\n"));
+    bench_begin();
+    for (u32 i = 0; i < 1000; i++) {
+      bench.sink += (u64)strstr(s.buff, "window_title");
+    }
+    bench_end("string_find", "strstr 4 KiB", s.size, 1000);
+    bench_begin();
+    for (u32 i = 0; i < 1000; i++) {
+      bench.sink += (u64)string_find(s, STR("window_title"));
+    }
+    bench_end("string_find", "4 KiB", s.size, 1000);
+    bench_begin();
+    for (u32 i = 0; i < 1000; i++) {
+      bench.sink += string_count(s, '\n');
+    }
+    bench_end("string_count", "4 KiB", s.size, 1000);
+    bench_begin();
+    for (u32 i = 0; i < 1000; i++) {
+      str rest = s, line;
+      while (string_split(&rest, '\n', &line)) bench.sink += line.size;
+    }
+    bench_end("string_split", "4 KiB lines", s.size, 1000);
+    string_destroy(s);
+  }
+  if (bench_enabled("string_utf8")) {
+    /* 4 KiB of ASCII and then of mostly two byte codepoints */
+    str ascii = string_create(STR_0);
+    str utf8  = string_create(STR_0);
+    for (u32 i = 0; i < 256; i++) string_concat(&ascii, STR("key_name = 123\n"));
+    for (u32 i = 0; i < 256; i++) string_concat(&utf8, STR("ключ = 12\n"));
+    bench_begin();
+    for (u32 i = 0; i < 1000; i++) bench.sink += string_utf8_valid(ascii);
+    bench_end("string_utf8_valid", "4 KiB ascii", ascii.size, 1000);
+    bench_begin();
+    for (u32 i = 0; i < 1000; i++) bench.sink += string_utf8_valid(utf8);
+    bench_end("string_utf8_valid", "4 KiB cyrillic", utf8.size, 1000);
+    bench_begin();
+    for (u32 i = 0; i < 1000; i++) bench.sink += string_utf8_length(ascii);
+    bench_end("string_utf8_length", "4 KiB ascii", ascii.size, 1000);
+    bench_begin();
+    for (u32 i = 0; i < 1000; i++) bench.sink += string_utf8_length(utf8);
+    bench_end("string_utf8_length", "4 KiB cyrillic", utf8.size, 1000);
+    string_destroy(ascii);
+    string_destroy(utf8);
+  }
+  if (bench_enabled("string_build")) {
+    /* a HUD line built again every frame */
+    const u32 frames = 10000;
+    char line[64];
+    str s = string_create(STR_0);
+    bench_begin();
+    for (u32 i = 0; i < frames; i++) {
+      snprintf(line, sizeof (line), "SCORE: %u TIME: %.2f", i * 10, i * 0.016);
+      str tmp = string_create((str) { strlen(line), 0, line });
+      bench.sink += tmp.size;
+      string_destroy(tmp);
+    }
+    bench_end("string_build", "snprintf string_create", frames, frames);
+    bench_begin();
+    for (u32 i = 0; i < frames; i++) {
+      string_clear(&s);
+      string_format(&s, STR("SCORE: %u TIME: %.2f"), i * 10, i * 0.016);
+      bench.sink += s.size;
+    }
+    bench_end("string_build", "string_format", frames, frames);
+    bench_begin();
+    for (u32 i = 0; i < frames; i++) {
+      string_clear(&s);
+      string_concat(&s, STR("SCORE: "));
+      string_append_u64(&s, i * 10);
+      string_concat(&s, STR(" TIME: "));
+      string_append_f64(&s, i * 0.016, 2);
+      bench.sink += s.size;
+    }
+    bench_end("string_build", "string_append", frames, frames);
+    string_destroy(s);
+  }
+  if (bench_enabled("text_buffer")) {
+    /* typing in the middle of a 64 KiB text, a newline every 16 chars */
+    const u32 keys = 20000;
+    str text = string_create(STR_0);
+    for (u32 i = 0; i < 4096; i++) string_concat(&text, STR("key_name = 123\n"));
+    str s = string_create(text);
+    bench_begin();
+    for (u32 i = 0; i < keys; i++) {
+      string_insert(&s, i % 16 == 15 ? STR("\n") : STR("a"), text.size / 2 + i);
+    }
+    bench_end("text_buffer_insert", "string_insert", keys, keys);
+    text_buffer *buffer = text_buffer_create(text);
+    text_buffer_seek(buffer, text.size / 2);
+    bench_begin();
+    for (u32 i = 0; i < keys; i++) {
+      text_buffer_insert_utf8(buffer, i % 16 == 15 ? '\n' : 'a');
+    }
+    bench_end("text_buffer_insert", "text_buffer", keys, keys);
+    bench_begin();
+    for (u32 i = 0; i < keys; i++) {
+      bench.sink += text_buffer_line(buffer, (i * 7919) % text_buffer_lines(buffer)).size;
+    }
+    bench_end("text_buffer_line", "random", keys, keys);
+    bench_begin();
+    for (u32 i = 0; i < keys; i++) {
+      bench.sink += text_buffer_line_at(buffer, (i * 7919) % text_buffer_size(buffer));
+    }
+    bench_end("text_buffer_line_at", "random", keys, keys);
+    text_buffer_destroy(buffer);
+    string_destroy(s);
+    string_destroy(text);
+  }
+}
+
+/*
+ * Array List
+ */
+
+ARRAY_LIST_SETUP(u32_list, u32)
+
+static b8
+bench_is_odd(void *item, void *ctx) {
+  (void)ctx;
+  return *(u32 *)item & 1;
+}
+
+static void
+bench_array_list(void) {
+  for (u32 n = 1000; n <= bench.max_n; n *= 10) {
+    if (bench_enabled("array_list_push")) {
+      u32 *arr = array_list_create(sizeof (u32));
+      bench_begin();
+      for (u32 i = 0; i < n; i++) {
+        array_list_push(arr, i);
+      }
+      bench_end("array_list_push", "u32", n, n);
+      array_list_destroy(arr);
+
+      arr = u32_list_create();
+      bench_begin();
+      for (u32 i = 0; i < n; i++) {
+        arr = u32_list_push(arr, i);
+      }
+      bench_end("array_list_push", "u32 typed", n, n);
+      array_list_destroy(arr);
+    }
+    if (bench_enabled("segment_list_push")) {
+      segment_list *list = segment_list_create(sizeof (u32), 0);
+      bench_begin();
+      for (u32 i = 0; i < n; i++) {
+        segment_list_push(list, &i);
+      }
+      bench_end("segment_list_push", "u32", n, n);
+      bench_begin();
+      for (u32 s = 0, size; s < segment_list_segments(list); s++) {
+        u32 *items = segment_list_segment(list, s, &size);
+        for (u32 i = 0; i < size; i++) bench.sink += items[i];
+      }
+      bench_end("segment_list_iterate", "u32", n, n);
+      segment_list_destroy(list);
+    }
+    if (bench_enabled("array_list_pop")) {
+      u32 *arr = array_list_create(sizeof (u32));
+      for (u32 i = 0; i < n; i++) array_list_push(arr, i);
+      bench_begin();
+      for (u32 i = 0; i < n; i++) {
+        u32 out;
+        array_list_pop(arr, &out);
+        bench.sink += out;
+      }
+      bench_end("array_list_pop", "u32", n, n);
+      array_list_destroy(arr);
+    }
+    if (bench_enabled("array_list_swap_remove")) {
+      u32 *arr = array_list_create(sizeof (u32));
+      for (u32 i = 0; i < n; i++) array_list_push(arr, i);
+      bench_begin();
+      for (u32 i = 0; i < n; i++) {
+        array_list_swap_remove(arr, 0, 0);
+      }
+      bench_end("array_list_swap_remove", "front", n, n);
+      array_list_destroy(arr);
+    }
+    if (bench_enabled("array_list_remove_if")) {
+      u32 *arr = array_list_create(sizeof (u32));
+      for (u32 i = 0; i < n; i++) array_list_push(arr, (u32)bench_mix(i));
+      bench_begin();
+      bench.sink += array_list_remove_if(arr, bench_is_odd, 0);
+      bench_end("array_list_remove_if", "half", n, n);
+      array_list_destroy(arr);
+    }
+    if (bench_enabled("array_list_keep_mask")) {
+      u32 *arr  = array_list_create(sizeof (u32));
+      b8  *keep = malloc(n);
+      for (u32 i = 0; i < n; i++) {
+        array_list_push(arr, i);
+        keep[i] = bench_mix(i) & 1;
+      }
+      bench_begin();
+      bench.sink += array_list_keep_mask(arr, keep);
+      bench_end("array_list_keep_mask", "half", n, n);
+      array_list_destroy(arr);
+      free(keep);
+    }
+    /* insert, remove and shift are O(n) per call, keep them small */
+    if (n > 100000) continue;
+    if (bench_enabled("array_list_insert")) {
+      u32 *arr = array_list_create(sizeof (u32));
+      array_list_push(arr, 0);
+      bench_begin();
+      for (u32 i = 0; i < n; i++) {
+        array_list_insert(arr, array_list_size(arr) / 2, i);
+      }
+      bench_end("array_list_insert", "middle", n, n);
+      array_list_destroy(arr);
+    }
+    if (bench_enabled("array_list_remove")) {
+      u32 *arr = array_list_create(sizeof (u32));
+      for (u32 i = 0; i < n; i++) array_list_push(arr, i);
+      bench_begin();
+      for (u32 i = 0; i < n; i++) {
+        array_list_remove(arr, 0, 0);
+      }
+      bench_end("array_list_remove", "front", n, n);
+      array_list_destroy(arr);
+    }
+    if (bench_enabled("array_list_shift")) {
+      u32 *arr = array_list_create(sizeof (u32));
+      for (u32 i = 0; i < n; i++) array_list_push(arr, i);
+      bench_begin();
+      for (u32 i = 0; i < 1000; i++) {
+        array_list_shift_right(arr, 0, 1);
+        array_list_shift_left(arr, 1, 1);
+      }
+      bench_end("array_list_shift", "u32", n, 2000);
+      array_list_destroy(arr);
+    }
+  }
+}
+
+/*
+ * Memory
+ */
+
+static void
+bench_memory(void) {
+  for (u32 n = 1000; n <= bench.max_n; n *= 10) {
+    if (bench_enabled("arena_alloc")) {
+      void **ptrs = malloc(sizeof (void *) * n);
+      bench_begin();
+      for (u32 i = 0; i < n; i++) ptrs[i] = bench_malloc(16 + (i & 63));
+      for (u32 i = 0; i < n; i++) free(ptrs[i]);
+      bench_end("arena_alloc", "malloc free", n, n);
+      free(ptrs);
+
+      arena *arena = arena_create(64 * 1024);
+      arena_alloc(arena, (u64)n * 128, 16);
+      arena_reset(arena);
+      bench_begin();
+      for (u32 i = 0; i < n; i++) bench.sink += (uintptr_t)arena_alloc(arena, 16 + (i & 63), 16);
+      arena_reset(arena);
+      bench_end("arena_alloc", "arena reset", n, n);
+
+      bench_begin();
+      u32 *list = array_list_create_with(sizeof (u32), arena_allocator(arena));
+      for (u32 i = 0; i < n; i++) array_list_push(list, i);
+      bench.sink += list[n / 2];
+      arena_reset(arena);
+      bench_end("arena_alloc", "array_list_push", n, n);
+      arena_destroy(arena);
+    }
+    if (bench_enabled("pool_alloc")) {
+      void **ptrs = malloc(sizeof (void *) * n);
+      bench_begin();
+      for (u32 i = 0; i < n; i++) ptrs[i] = bench_malloc(48);
+      for (u32 i = 0; i < n; i++) free(ptrs[(u64)i * 7919 % n]);
+      bench_end("pool_alloc", "malloc free", n, n);
+
+      pool *pool = pool_create(48, 0);
+      bench_begin();
+      for (u32 i = 0; i < n; i++) ptrs[i] = pool_alloc(pool);
+      for (u32 i = 0; i < n; i++) pool_free(pool, ptrs[(u64)i * 7919 % n]);
+      bench_end("pool_alloc", "pool free", n, n);
+
+      bench_begin();
+      for (u32 i = 0; i < n; i++) ptrs[i] = pool_alloc(pool);
+      for (u32 i = 0; i < n; i++) pool_free(pool, ptrs[(u64)i * 7919 % n]);
+      bench_end("pool_alloc", "pool reused", n, n);
+      pool_destroy(pool);
+      free(ptrs);
+    }
+    if (bench_enabled("region_scene")) {
+      /* a scene made of many small lists, torn down at once */
+      u32 lists_amount = n / 100;
+      u32 **lists = malloc(sizeof (u32 *) * lists_amount);
+      bench_begin();
+      for (u32 i = 0; i < lists_amount; i++) {
+        lists[i] = array_list_create(sizeof (u32));
+        for (u32 j = 0; j < 100; j++) array_list_push(lists[i], j);
+      }
+      for (u32 i = 0; i < lists_amount; i++) array_list_destroy(lists[i]);
+      bench_end("region_scene", "array_list_destroy", n, n);
+
+      region *region = region_create(64 * 1024);
+      bench_begin();
+      region_begin(region);
+      for (u32 i = 0; i < lists_amount; i++) {
+        lists[i] = array_list_create(sizeof (u32));
+        for (u32 j = 0; j < 100; j++) array_list_push(lists[i], j);
+      }
+      region_end();
+      region_reset(region);
+      bench_end("region_scene", "region_reset", n, n);
+      region_destroy(region);
+      free(lists);
+    }
+  }
+}
+
+/*
+ * Sorting
+ */
+
+static s32
+bench_compare_u32(const void *a, const void *b) {
+  u32 x = *(const u32 *)a;
+  u32 y = *(const u32 *)b;
+  return (x > y) - (x < y);
+}
+
+static void
+bench_sort(void) {
+  for (u32 n = 1000; n <= bench.max_n; n *= 10) {
+    u32 *keys   = malloc(sizeof (u32) * n);
+    u32 *items  = malloc(sizeof (u32) * n);
+    quad *quads = malloc(sizeof (quad) * n);
+    for (u32 i = 0; i < n; i++) {
+      keys[i] = (u32)bench_mix(i);
+      quads[i][0].position.y = (f32)(keys[i] % 10000) - 5000;
+    }
+#define BENCH_SORT(NAME, KEY, SORT) do {\
+      if (bench_enabled(NAME)) {\
+        memcpy(items, keys, sizeof (u32) * n);\
+        bench_begin();\
+        SORT;\
+        bench_end(NAME, KEY, n, n);\
+      }\
+    } while (0)
+    BENCH_SORT("sort_qsort", "u32", qsort(items, n, sizeof (u32), bench_compare_u32));
+    BENCH_SORT("sort_intro", "u32", sort_intro(items, n, sizeof (u32), bench_compare_u32));
+    BENCH_SORT("sort_radix", "u32", sort_radix(items, n, sizeof (u32), 0, SORT_KEY_U32, 0));
+    BENCH_SORT("sort_radix", "u32 parallel", sort_radix(items, n, sizeof (u32), 0, SORT_KEY_U32, SORT_PARALLEL));
+    BENCH_SORT("sort_radix", "f32", sort_radix(items, n, sizeof (u32), 0, SORT_KEY_F32, 0));
+#undef BENCH_SORT
+    if (bench_enabled("sort_radix")) {
+      bench_begin();
+      sort_radix(quads, n, sizeof (quad), offsetof(vertex, position) + offsetof(v2f, y), SORT_KEY_F32, SORT_DESCENDING);
+      bench_end("sort_radix", "quad y", n, n);
+    }
+    bench.sink += items[n / 2] + (u32)quads[0][0].position.y;
+    free(keys);
+    free(items);
+    free(quads);
+  }
+}
+
+/*
+ * Hashing
+ */
+
+static void
+bench_hash(void) {
+  const u32 n = 1000000;
+  if (bench_enabled("hash_str")) {
+    static const u32 sizes[] = { 8, 25, 256 };
+    char buff[256];
+    for (u32 i = 0; i < sizeof (buff); i++) buff[i] = 'a' + i % 26;
+    for (u32 s = 0; s < sizeof (sizes) / sizeof (sizes[0]); s++) {
+      char key[16];
+      snprintf(key, sizeof (key), "%u bytes", sizes[s]);
+      bench_begin();
+      for (u32 i = 0; i < n; i++) {
+        buff[0] = (char)i;
+        bench.sink += hash_str((str) { .size = sizes[s], .buff = buff });
+      }
+      bench_end("hash_str", key, sizes[s], n);
+    }
+  }
+  if (bench_enabled("hash_u64")) {
+    bench_begin();
+    for (u32 i = 0; i < n; i++) {
+      bench.sink += hash_u64(i);
+    }
+    bench_end("hash_u64", "u64", 1, n);
+  }
+  if (bench_enabled("hash_u128")) {
+    bench_begin();
+    for (u32 i = 0; i < n; i++) {
+      bench.sink += hash_u128((u128) { .u64 = { i, bench.sink } });
+    }
+    bench_end("hash_u128", "u128", 1, n);
+  }
+  if (bench_enabled("atom_intern")) {
+    /* an already interned name, as looked up every frame */
+    str name = STR("entity_component_position");
+    bench_begin();
+    for (u32 i = 0; i < n; i++) {
+      bench.sink += atom_intern(name);
+    }
+    bench_end("atom_intern", "25 bytes", 1, n);
+    bench_begin();
+    for (u32 i = 0; i < n; i++) {
+      bench.sink += ATOM("entity_component_position");
+    }
+    bench_end("atom_intern", "25 bytes ATOM()", 1, n);
+  }
+}
+
+/*
+ * Hash Table
+ */
+
+HASH_TABLE_SETUP(u64_table, u64, u32, hash_u64, HASH_TABLE_EQUAL)
+
+static ccstr bench_key_names[] = {
+  [HT_STR]  = "str",
+  [HT_U64]  = "u64",
+  [HT_U128] = "u128",
+  [HT_U32]  = "u32",
+  [HT_BYTES] = "v2i"
+};
+
+/* HT_BYTES tables are benchmarked with grid cell keys. */
+static u32
+bench_key_size(hash_table_type key_type) {
+  return key_type == HT_BYTES ? sizeof (v2i) : hash_table_key_size[key_type];
+}
+
+static hash_table *
+bench_hash_table_create(hash_table_type key_type) {
+  if (key_type == HT_BYTES) return hash_table_create_bytes(sizeof (u32), sizeof (v2i), 0, 0);
+  return hash_table_create(sizeof (u32), key_type);
+}
+
+/* Fills `keys` with `n` keys of `key_type`. String keys buffers live in `chars`. */
+static void
+bench_keys_fill(hash_table_type key_type, void *keys, cstr chars, u32 n, u64 seed) {
+  for (u32 i = 0; i < n; i++) {
+    u64 x = bench_mix(seed + i);
+    switch (key_type) {
+      case HT_STR:
+      {
+        str *key  = (str *)keys + i;
+        key->buff = chars + i * 24;
+        key->size = sprintf(key->buff, "key_%lx", (unsigned long)x);
+        key->capa = 0;
+      } break;
+      case HT_U64:
+        ((u64 *)keys)[i] = x;
+        break;
+      case HT_U128:
+        ((u128 *)keys)[i].u64[0] = x;
+        ((u128 *)keys)[i].u64[1] = bench_mix(x);
+        break;
+      /* multiplying by an odd number is a bijection, so these never collide */
+      case HT_U32:
+        ((u32 *)keys)[i] = (i + (seed ? n : 0)) * 0x9e3779b9u;
+        break;
+      case HT_BYTES:
+        ((v2i *)keys)[i] = V2I(i % 1024, i / 1024 + (seed ? n : 0));
+        break;
+      case HT_AMOUNT: break;
+    }
+  }
+}
+
+static void
+bench_hash_table(void) {
+  for (hash_table_type key_type = 0; key_type < HT_AMOUNT; key_type++) {
+    u32 key_size = bench_key_size(key_type);
+    for (u32 n = 1000; n <= bench.max_n; n *= 10) {
+      u8   *hit_keys  = malloc(key_size * n);
+      u8   *miss_keys = malloc(key_size * n);
+      cstr  hit_chars  = key_type == HT_STR ? malloc(24 * n) : 0;
+      cstr  miss_chars = key_type == HT_STR ? malloc(24 * n) : 0;
+      bench_keys_fill(key_type, hit_keys,  hit_chars,  n, 0);
+      bench_keys_fill(key_type, miss_keys, miss_chars, n, UINT64_C(1) << 40);
+
+      hash_table *ht = bench_hash_table_create(key_type);
+      if (bench_enabled("hash_table_add")) bench_begin();
+      for (u32 i = 0; i < n; i++) {
+        *(u32 *)hash_table_add(ht, hit_keys + i * key_size) = i;
+      }
+      if (bench_enabled("hash_table_add")) bench_end("hash_table_add", bench_key_names[key_type], n, n);
+
+      if (bench_enabled("hash_table_add_reserved")) {
+        hash_table *reserved = bench_hash_table_create(key_type);
+        bench_begin();
+        hash_table_reserve(reserved, n);
+        for (u32 i = 0; i < n; i++) {
+          *(u32 *)hash_table_add(reserved, hit_keys + i * key_size) = i;
+        }
+        bench_end("hash_table_add_reserved", bench_key_names[key_type], n, n);
+        hash_table_destroy(reserved);
+      }
+
+      if (bench_enabled("hash_table_get_hit")) {
+        bench_begin();
+        for (u32 i = 0; i < n; i++) {
+          bench.sink += *(u32 *)hash_table_get(ht, hit_keys + i * key_size);
+        }
+        bench_end("hash_table_get_hit", bench_key_names[key_type], n, n);
+      }
+
+      if (key_type == HT_U64) {
+        hash_table *typed = u64_table_create();
+        if (bench_enabled("hash_table_add")) bench_begin();
+        for (u32 i = 0; i < n; i++) *u64_table_add(typed, ((u64 *)hit_keys)[i]) = i;
+        if (bench_enabled("hash_table_add")) bench_end("hash_table_add", "u64 typed", n, n);
+        if (bench_enabled("hash_table_get_hit")) {
+          bench_begin();
+          for (u32 i = 0; i < n; i++) {
+            bench.sink += *u64_table_get(typed, ((u64 *)hit_keys)[i]);
+          }
+          bench_end("hash_table_get_hit", "u64 typed", n, n);
+        }
+        if (bench_enabled("hash_table_del")) {
+          bench_begin();
+          for (u32 i = 0; i < n; i++) u64_table_del(typed, ((u64 *)hit_keys)[i]);
+          bench_end("hash_table_del", "u64 typed", n, n);
+        }
+        hash_table_destroy(typed);
+      }
+
+      if (bench_enabled("hash_table_get_batch")) {
+        void *vals[256];
+        bench_begin();
+        for (u32 i = 0; i < n; i += 256) {
+          u32 count = MIN(256, n - i);
+          hash_table_get_batch(ht, hit_keys + i * key_size, count, vals);
+          for (u32 j = 0; j < count; j++) bench.sink += *(u32 *)vals[j];
+        }
+        bench_end("hash_table_get_batch", bench_key_names[key_type], n, n);
+      }
+
+      if (bench_enabled("hash_table_get_miss")) {
+        bench_begin();
+        for (u32 i = 0; i < n; i++) {
+          bench.sink += (u64)hash_table_get(ht, miss_keys + i * key_size);
+        }
+        bench_end("hash_table_get_miss", bench_key_names[key_type], n, n);
+      }
+
+#ifdef BLIB_CONTAINER_STATS
+      if (n == bench.max_n) hash_table_stats_dump(ht, bench_key_names[key_type]);
+#endif
+
+      if (bench_enabled("hash_table_del")) {
+        bench_begin();
+        for (u32 i = 0; i < n; i++) {
+          hash_table_del(ht, hit_keys + i * key_size);
+        }
+        bench_end("hash_table_del", bench_key_names[key_type], n, n);
+      }
+
+      hash_table_destroy(ht);
+      free(hit_keys);
+      free(miss_keys);
+      free(hit_chars);
+      free(miss_chars);
+    }
+  }
+}
+
+/*
+ * Entity System
+ */
+
+static void
+bench_entity(void) {
+  for (u32 n = 1000; n <= bench.max_n && n <= 1000000; n *= 10) {
+    entity *entities = malloc(sizeof (entity) * n);
+    str type_name = STR("bench");
+    if (!atom_find(type_name)) {
+      entity_type_begin(type_name);
+        entity_type_add_component(STR("position"), sizeof (v2f));
+        entity_type_add_component(STR("velocity"), sizeof (v2f));
+        entity_type_add_component(STR("health"),   sizeof (u32));
+      entity_type_end();
+    }
+
+    bench_begin();
+    for (u32 i = 0; i < n; i++) {
+      entity_create(type_name, &entities[i]);
+    }
+    if (bench_enabled("entity_create")) bench_end("entity_create", "3 components", n, n);
+
+    if (bench_enabled("entity_get_component")) {
+      bench_begin();
+      for (u32 i = 0; i < n; i++) {
+        v2f *position = entity_get_component(&entities[i], STR("position"));
+        position->x += 1;
+      }
+      bench_end("entity_get_component", "position", n, n);
+      atom position_atom = ATOM("position");
+      bench_begin();
+      for (u32 i = 0; i < n; i++) {
+        v2f *position = entity_get_component_atom(&entities[i], position_atom);
+        position->x += 1;
+      }
+      bench_end("entity_get_component", "position atom", n, n);
+      component_id position_id = entity_type_find_component(entity_type_find(type_name), STR("position"));
+      bench_begin();
+      for (u32 i = 0; i < n; i++) {
+        v2f *position = entity_get_component_id(&entities[i], position_id);
+        position->x += 1;
+      }
+      bench_end("entity_get_component", "position id", n, n);
+    }
+
+    if (bench_enabled("entity_type_get_components")) {
+      bench_begin();
+      for (u32 i = 0; i < 100000; i++) {
+        bench.sink += (u64)entity_type_get_components(type_name, STR("velocity"));
+      }
+      bench_end("entity_type_get_components", "velocity", n, 100000);
+      atom type_atom = ATOM("bench"), velocity_atom = ATOM("velocity");
+      bench_begin();
+      for (u32 i = 0; i < 100000; i++) {
+        bench.sink += (u64)entity_type_get_components_atom(type_atom, velocity_atom);
+      }
+      bench_end("entity_type_get_components", "velocity atom", n, 100000);
+      entity_type_id type_id = entity_type_find(type_name);
+      component_id velocity_id = entity_type_find_component(type_id, STR("velocity"));
+      bench_begin();
+      for (u32 i = 0; i < 100000; i++) {
+        bench.sink += (u64)entity_type_get_components_id(type_id, velocity_id);
+      }
+      bench_end("entity_type_get_components", "velocity id", n, 100000);
+    }
+
+    /* destroying from the back keeps the destruction from reindexing the whole type */
+    bench_begin();
+    for (u32 i = n - 1; i != (u32)-1; i--) {
+      entity_destroy_by_index(type_name, i);
+    }
+    if (bench_enabled("entity_destroy_by_index")) bench_end("entity_destroy_by_index", "back", n, n);
+
+    for (u32 i = 0; i < n; i++) {
+      entity_create(type_name, &entities[i]);
+    }
+    bench_begin();
+    for (u32 i = n - 1; i != (u32)-1; i--) {
+      entity_destroy(&entities[i]);
+    }
+    if (bench_enabled("entity_destroy")) bench_end("entity_destroy", "back", n, n);
+
+    entity_type_clear(type_name);
+    free(entities);
+  }
+}
+
+/*
+ * Rendering
+ *
+ * Only the quad submission is measured: the quads lists are cleared
+ * instead of being submitted to OpenGL.
+ */
+
+static void
+bench_renderer_setup(void) {
+  renderer.layers_amount       = 1;
+  renderer.quads_vertices_capa = (u32)-1;
+  renderer.quads_requests      = malloc(sizeof (quad **));
+  renderer.quads_requests[0]   = malloc(sizeof (quad *) * BATCH_SHADERS_AMOUNT);
+  for (u32 i = 0; i < BATCH_SHADERS_AMOUNT; i++) {
+    renderer.quads_requests[0][i] = array_list_create(sizeof (quad));
+  }
+
+  str atlas_name = STR("bench");
+  atom atlas_atom = atom_intern(atlas_name);
+  texture_atlas *atlas = hash_table_add(asset_manager.atlases, &atlas_atom);
+  memset(atlas, 0, sizeof (texture_atlas));
+  atlas->width        = 256;
+  atlas->height       = 256;
+  atlas->pixel_size   = V2F(1.0f / 256, 1.0f / 256);
+  atlas->tile_size_px = V2F(16, 16);
+  atlas->tile_size    = v2f_mul(atlas->pixel_size, atlas->tile_size_px);
+
+  str font_name = DEFAULT_SPRITE_FONT;
+  atom font_atom = atom_intern(font_name);
+  sprite_font *font = hash_table_add(asset_manager.sprite_fonts, &font_atom);
+  memset(font, 0, sizeof (sprite_font));
+  font->width        = 752;
+  font->height       = 8;
+  font->pixel_size   = V2F(1.0f / 752, 1.0f / 8);
+  font->char_size_px = V2F(8, 8);
+  font->char_size    = v2f_mul(font->pixel_size, font->char_size_px);
+  sprite_font_layout(font, 0);
+
+  renderer.batch.atlas = atlas_name;
+  renderer.batch.font  = font_name;
+}
+
+static void
+bench_renderer_flush(void) {
+  for (u32 i = 0; i < BATCH_SHADERS_AMOUNT; i++) {
+    array_list_clear(renderer.quads_requests[0][i]);
+  }
+  renderer.quads_amount = 0;
+}
+
+static void
+bench_renderer(void) {
+  const u32 n = 100000;
+  bench_renderer_setup();
+  /* warm up the quads lists so the measured loops don't reallocate them */
+  for (u32 i = 0; i < n; i++) {
+    draw_rect(V2F_0, V2F(16, 16), V2F_0, 0, COL_WHITE, 0);
+    draw_tile(V2U(1, 1), V2F_0, V2F(1, 1), V2F_0, 0, COL_WHITE, 0);
+    draw_text(V2F_0, V2F(1, 1), COL_WHITE, 0, STR("a"));
+  }
+  bench_renderer_flush();
+
+  if (bench_enabled("draw_rect")) {
+    bench_begin();
+    for (u32 i = 0; i < n; i++) {
+      draw_rect(V2F(i & 0xff, i >> 8), V2F(16, 16), V2F_0, i * 0.01f, COL_WHITE, 0);
+    }
+    bench_end("draw_rect", "rotated", n, n);
+    bench_renderer_flush();
+  }
+  if (bench_enabled("draw_tile")) {
+    bench_begin();
+    for (u32 i = 0; i < n; i++) {
+      draw_tile(V2U(i & 0xf, 0), V2F(i & 0xff, i >> 8), V2F(1, 1), V2F_0, 0, COL_WHITE, 0);
+    }
+    bench_end("draw_tile", "unrotated", n, n);
+    bench_renderer_flush();
+  }
+  if (bench_enabled("draw_text")) {
+    const u32 m = n / 16;
+    bench_begin();
+    for (u32 i = 0; i < m; i++) {
+      draw_text(V2F_0, V2F(1, 1), COL_WHITE, 0, STR("SCORE: %08u"), i);
+    }
+    bench_end("draw_text", "15 chars", m, m);
+    bench_renderer_flush();
+    /* the codepoints past ASCII are looked up on the glyph table */
+    sprite_font_map(DEFAULT_SPRITE_FONT, 0x410, 64, 95);
+    bench_begin();
+    for (u32 i = 0; i < m; i++) {
+      draw_text(V2F_0, V2F(1, 1), COL_WHITE, 0, STR("СЧЁТ: %08u"), i);
+    }
+    bench_end("draw_text", "14 chars utf-8", m, m);
+    bench_renderer_flush();
+  }
+}
+
+s32
+main(s32 argc, cstr *argv) {
+  bench.out   = stdout;
+  bench.max_n = 1000000;
+  for (s32 i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "--max-n") && i + 1 < argc) {
+      bench.max_n = strtoul(argv[++i], 0, 10);
+    } else if (!strcmp(argv[i], "--filter") && i + 1 < argc) {
+      bench.filter = argv[++i];
+    } else if (!strcmp(argv[i], "--out") && i + 1 < argc) {
+      bench.out = fopen(argv[++i], "w");
+      if (!bench.out) {
+        err("couldn't open '%s'\n", argv[i]);
+        return 1;
+      }
+    } else {
+      err("usage: %s [--max-n N] [--filter NAME] [--out FILE]\n", argv[0]);
+      return 1;
+    }
+  }
+
+  srand(0);
+  entity_system_init();
+  asset_manager_init();
+
+  fprintf(bench.out, "benchmark,key,n,ops,ns_per_op,allocs_per_op\n");
+  bench_string();
+  bench_array_list();
+  bench_memory();
+  bench_sort();
+  bench_hash();
+  bench_hash_table();
+  bench_entity();
+  bench_renderer();
+
+  if (bench.out != stdout) fclose(bench.out);
+  return bench.sink == 0xdeadbeef;
+}
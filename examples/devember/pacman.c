@@ -82,6 +82,7 @@ static cstr map =
 
 static v2u *obstacles_tiles;
 static v2f *obstacles_pos;
+static hash_table *obstacles_cells;
 static v2f *big_coins;
 static v2f *coins;
 
@@ -112,10 +113,17 @@ static pac_entity ghosts[4];
 #define PACMAN_ANIM_SPEED 15
 #define PACMAN_SPEED 10
 
+/* the map cell of a position, it's the key of `obstacles_cells` */
+static v2i
+tile_cell(v2f p) {
+  return V2I((s32)p.x / TILE_SIZE, (s32)p.y / TILE_SIZE);
+}
+
 static void
 game_start(void) {
   array_list_clear(obstacles_pos);
   array_list_clear(obstacles_tiles);
+  hash_table_clear(obstacles_cells);
   array_list_clear(big_coins);
   array_list_clear(coins);
   u32 ghost_setup = 0;
@@ -180,6 +188,10 @@ game_start(void) {
         case TILE_OBSTACLE:
           array_list_push(obstacles_tiles, tile);
           array_list_push(obstacles_pos, pos);
+          {
+            v2i cell = tile_cell(pos);
+            if (!hash_table_get(obstacles_cells, &cell)) hash_table_add(obstacles_cells, &cell);
+          }
           break;
         case TILE_BIG_COIN:
           array_list_push(big_coins, pos);
@@ -216,6 +228,12 @@ collided(v2f p1, v2f p2) {
   return a.x == b.x && a.y == b.y;
 }
 
+static b8
+obstacle_at(v2f p) {
+  v2i cell = tile_cell(p);
+  return hash_table_get(obstacles_cells, &cell) != 0;
+}
+
 static s32
 collided_list(v2f p, v2f *ps) {
   v2i a = { (s32)p.x / TILE_SIZE, (s32)p.y / TILE_SIZE };
@@ -254,11 +272,11 @@ move_entity(pac_entity *e, f32 dt, f32 speed, f32 anim_speed, u32 frames_amount,
     }
   }
   if (!e->moving) {
-    if (collided_list(v2f_add(e->nxt, dir_pos[e->nxt_dir]), obstacles_pos) == -1) {
+    if (!obstacle_at(v2f_add(e->nxt, dir_pos[e->nxt_dir]))) {
       e->dir = e->nxt_dir;
     } 
     e->nxt = v2f_add(e->nxt, dir_pos[e->dir]);
-    if (collided_list(e->nxt, obstacles_pos) != -1) {
+    if (obstacle_at(e->nxt)) {
       e->nxt = e->pos;
     } else {
       e->moving = true;
@@ -298,6 +316,7 @@ __init(void) {
 
   obstacles_tiles = array_list_create(sizeof (v2u));
   obstacles_pos   = array_list_create(sizeof (v2f));
+  obstacles_cells = hash_table_create_bytes(sizeof (u8), sizeof (v2i), 0, 0);
   big_coins       = array_list_create(sizeof (v2f));
   coins           = array_list_create(sizeof (v2f));
 
@@ -0,0 +1,252 @@
+/*
+ * Asteroids stress scene.
+ *
+ * A scripted session of asteroids with a field full of rocks: the ship
+ * spins in the center firing a volley every frame. Runs for STRESS_FRAMES
+ * frames then closes and reports the frame time percentiles.
+ *
+ * Parameters (compile with -DNAME=VALUE):
+ *   STRESS_ASTEROIDS     large asteroids created at the start
+ *   STRESS_PROJECTILES   max projectiles alive at the same time
+ *   STRESS_VOLLEY        projectiles fired every frame
+ *   STRESS_FRAMES        session length in frames
+ * */
+
+#include <blib.h>
+
+#ifndef STRESS_ASTEROIDS
+#define STRESS_ASTEROIDS 50000
+#endif
+
+#ifndef STRESS_PROJECTILES
+#define STRESS_PROJECTILES 50000
+#endif
+
+#ifndef STRESS_VOLLEY
+#define STRESS_VOLLEY 64
+#endif
+
+#ifndef STRESS_FRAMES
+#define STRESS_FRAMES 600
+#endif
+
+#define GAME_W 960
+#define GAME_H 720
+
+#define GAME_LEFT   (-GAME_W * 0.5f)
+#define GAME_RIGHT  (+GAME_W * 0.5f)
+#define GAME_BOTTOM (-GAME_H * 0.5f)
+#define GAME_TOP    (+GAME_H * 0.5f)
+
+typedef struct {
+  v2f pos;
+  f32 angle;
+} projectile;
+
+typedef struct {
+  v2f points[8];
+  v2f pos;
+  u32 cell_size;
+
+  f32 angle;
+  f32 speed;
+
+  f32 left;
+  f32 right;
+  f32 bottom;
+  f32 top;
+} asteroid;
+
+#define PLAYER_PROJECTILE_SPEED 500
+#define PLAYER_ROT_SPEED 5
+
+#define ASTEROID_LARGE_CELL  32
+#define ASTEROID_MEDIUM_CELL 16
+#define ASTEROID_SMALL_CELL  8
+
+static f32 player_angle;
+static u32 player_score;
+static projectile *player_projectiles;
+static asteroid *asteroids;
+static u32 frames;
+
+static void
+create_asteroid(v2f pos, f32 cell_size, f32 min_speed, f32 max_speed) {
+  asteroid asteroid;
+  asteroid.pos = pos;
+  asteroid.speed = RAND_1() * (max_speed + min_speed) - min_speed;
+  asteroid.angle = RAND_1() * 2 * PI;
+  u32 points_amount = 0;
+  asteroid.right  = +INFINITY;
+  asteroid.left   = -INFINITY;
+  asteroid.top    = +INFINITY;
+  asteroid.bottom = -INFINITY;
+  asteroid.cell_size = cell_size;
+  for (s32 i = -1; i < 2; i++) {
+    for (s32 j = -1; j < 2; j++) {
+      if (i == 0 && j == 0) continue;
+      asteroid.points[points_amount] = V2F(
+        RAND_1() * cell_size + cell_size * i,
+        RAND_1() * cell_size + cell_size * j
+      );
+      if (j == -1 && asteroid.points[points_amount].y > asteroid.bottom) {
+        asteroid.bottom = asteroid.points[points_amount].y;
+      }
+      if (j == +1 && asteroid.points[points_amount].y < asteroid.top) {
+        asteroid.top = asteroid.points[points_amount].y;
+      }
+      if (i == +1 && asteroid.points[points_amount].x < asteroid.right) {
+        asteroid.right = asteroid.points[points_amount].x;
+      }
+      if (i == -1 && asteroid.points[points_amount].x > asteroid.left) {
+        asteroid.left = asteroid.points[points_amount].x;
+      }
+      points_amount++;
+    }
+  }
+  array_list_push(asteroids, asteroid);
+}
+
+static void
+player_shoot(f32 dt) {
+  /* Scripted player: fires a volley spread around its angle */
+  for (u32 i = 0; i < STRESS_VOLLEY && array_list_size(player_projectiles) < STRESS_PROJECTILES; i++) {
+    projectile projectile = { V2F_0, player_angle + i * (2 * PI / STRESS_VOLLEY) };
+    array_list_push(player_projectiles, projectile);
+  }
+
+  /* update/destroy projectiles */
+  for (u32 i = array_list_size(player_projectiles) - 1; i < (u32)-1; i--) {
+    player_projectiles[i].pos.x +=
+      dt * cosf(player_projectiles[i].angle) * PLAYER_PROJECTILE_SPEED;
+    player_projectiles[i].pos.y +=
+      dt * sinf(player_projectiles[i].angle) * PLAYER_PROJECTILE_SPEED;
+    b8 hitted_asteroid = false;
+    for (u32 j = array_list_size(asteroids) - 1; j < (u32)-1; j--) {
+      if (player_projectiles[i].pos.x + 5 > asteroids[j].pos.x + asteroids[j].left  &&
+          player_projectiles[i].pos.x - 5 < asteroids[j].pos.x + asteroids[j].right &&
+          player_projectiles[i].pos.y - 5 < asteroids[j].pos.y + asteroids[j].top   &&
+          player_projectiles[i].pos.y + 5 > asteroids[j].pos.y + asteroids[j].bottom) {
+        switch (asteroids[j].cell_size) {
+          case ASTEROID_LARGE_CELL:
+            create_asteroid(asteroids[j].pos, ASTEROID_MEDIUM_CELL, 150, 200);
+            create_asteroid(asteroids[j].pos, ASTEROID_MEDIUM_CELL, 150, 200);
+            player_score += 10;
+            break;
+          case ASTEROID_MEDIUM_CELL:
+            create_asteroid(asteroids[j].pos, ASTEROID_SMALL_CELL, 200, 250);
+            create_asteroid(asteroids[j].pos, ASTEROID_SMALL_CELL, 200, 250);
+            create_asteroid(asteroids[j].pos, ASTEROID_SMALL_CELL, 200, 250);
+            create_asteroid(asteroids[j].pos, ASTEROID_SMALL_CELL, 200, 250);
+            player_score += 20;
+            break;
+          case ASTEROID_SMALL_CELL:
+            player_score += 40;
+            break;
+        }
+        array_list_swap_remove(asteroids, j, 0);
+        array_list_swap_remove(player_projectiles, i, 0);
+        hitted_asteroid = true;
+        break;
+      }
+    }
+    if (hitted_asteroid) continue;
+    if (player_projectiles[i].pos.x > GAME_RIGHT  ||
+        player_projectiles[i].pos.x < GAME_LEFT   ||
+        player_projectiles[i].pos.y < GAME_BOTTOM ||
+        player_projectiles[i].pos.y > GAME_TOP) {
+      array_list_swap_remove(player_projectiles, i, 0);
+    }
+  }
+}
+
+static void
+asteroids_move(f32 dt) {
+  for (u32 i = 0; i < array_list_size(asteroids); i++) {
+    asteroids[i].pos.x += dt * cosf(asteroids[i].angle) * asteroids[i].speed;
+    asteroids[i].pos.y += dt * sinf(asteroids[i].angle) * asteroids[i].speed;
+    if (asteroids[i].pos.x < GAME_LEFT)   asteroids[i].pos.x = GAME_RIGHT;
+    if (asteroids[i].pos.x > GAME_RIGHT)  asteroids[i].pos.x = GAME_LEFT;
+    if (asteroids[i].pos.y < GAME_BOTTOM) asteroids[i].pos.y = GAME_TOP;
+    if (asteroids[i].pos.y > GAME_TOP)    asteroids[i].pos.y = GAME_BOTTOM;
+  }
+}
+
+void
+__conf(blib_config *config) {
+  config->window_title   = "STRESS: ASTEROIDS";
+  config->game_width     = GAME_W;
+  config->game_height    = GAME_H;
+  config->quads_capacity = 50000;
+  config->frame_stats    = true;
+}
+
+void
+__init(void) {
+  enable_vsync(false);
+  player_projectiles = array_list_create(sizeof (projectile));
+  asteroids          = array_list_create(sizeof (asteroid));
+  for (u32 i = 0; i < STRESS_ASTEROIDS; i++) {
+    v2f pos = {
+      RAND_1() * GAME_W - GAME_W * 0.5f,
+      RAND_1() * GAME_H - GAME_H * 0.5f
+    };
+    create_asteroid(pos, ASTEROID_LARGE_CELL, 100, 150);
+  }
+}
+
+void
+__loop(f32 dt) {
+  if (++frames >= STRESS_FRAMES) close_window();
+  player_angle += dt * PLAYER_ROT_SPEED;
+  player_shoot(dt);
+  asteroids_move(dt);
+}
+
+void
+__tick(f32 dt) {
+  (void)dt;
+}
+
+void
+__draw(batch *batch) {
+  (void)batch;
+  clear_screen(COL_BLACK);
+
+  /* draw player projectile */
+  for (u32 i = 0; i < array_list_size(player_projectiles); i++) {
+    draw_rect(player_projectiles[i].pos, V2F(6, 2), V2F_0,
+        player_projectiles[i].angle, COL_WHITE, 0);
+  }
+
+  /* draw asteroids */
+  for (u32 i = 0; i < array_list_size(asteroids); i++) {
+#define DRAW_ASTEROID_POINT(N1, N2) do { \
+      v2f p1 = v2f_add(asteroids[i].points[N1], asteroids[i].pos);\
+      v2f p2 = v2f_add(asteroids[i].points[N2], asteroids[i].pos);\
+      draw_line(p1, p2, 2, COL_WHITE, 0);\
+    } while (0)
+    DRAW_ASTEROID_POINT(0, 1);
+    DRAW_ASTEROID_POINT(1, 2);
+    DRAW_ASTEROID_POINT(2, 4);
+    DRAW_ASTEROID_POINT(4, 7);
+    DRAW_ASTEROID_POINT(7, 6);
+    DRAW_ASTEROID_POINT(6, 5);
+    DRAW_ASTEROID_POINT(5, 3);
+    DRAW_ASTEROID_POINT(3, 0);
+#undef DRAW_ASTEROID_POINT
+  }
+
+  draw_text(
+      V2F(GAME_LEFT + 20, GAME_TOP - 20), V2F_S(3),
+      COL_WHITE, 1, STR("ASTEROIDS: %u   SCORE: %u"), array_list_size(asteroids),
+      player_score);
+
+  submit_batch();
+}
+
+void
+__quit(void) {
+  array_list_destroy(player_projectiles);
+  array_list_destroy(asteroids);
+}
@@ -0,0 +1,199 @@
+/*
+ * Space invaders stress scene.
+ *
+ * A scripted session of invaders with a huge fleet: the player moves
+ * back and forth shooting every frame. Runs for STRESS_FRAMES frames
+ * then closes and reports the frame time percentiles.
+ *
+ * Parameters (compile with -DNAME=VALUE):
+ *   STRESS_INVADERS   invaders in the fleet
+ *   STRESS_BULLETS    max player bullets alive at the same time
+ *   STRESS_FRAMES     session length in frames
+ * */
+
+#include <blib.h>
+
+#ifndef STRESS_INVADERS
+#define STRESS_INVADERS 100000
+#endif
+
+#ifndef STRESS_BULLETS
+#define STRESS_BULLETS 64
+#endif
+
+#ifndef STRESS_FRAMES
+#define STRESS_FRAMES 600
+#endif
+
+#define TILE_SIZE 8
+
+#define GAME_W 640
+#define GAME_H 480
+
+#define GAME_TOP    (+GAME_H * 0.5f)
+#define GAME_RIGHT  (+GAME_W * 0.5f)
+#define GAME_BOTTOM (-GAME_H * 0.5f)
+#define GAME_LEFT   (-GAME_W * 0.5f)
+
+#define FLEET_COLUMNS 64
+#define FLEET_SPACING (TILE_SIZE * 0.5f)
+
+#define PLAYER_SPEED 200
+#define BULLET_SPEED 300
+#define BULLET_SIZE V2F(1, 4)
+
+static v2f player_position;
+static s32 player_dir;
+static v2f *player_bullets;
+
+static v2f *invaders;
+static u32 left_invader;
+static u32 right_invader;
+static f32 invaders_timer;
+static s32 invaders_dir;
+static f32 invaders_speed;
+#define INVADERS_ANIM_SPEED 2
+
+static u32 frames;
+
+static b8
+collided(v2f p1, v2f s1, v2f p2, v2f s2) {
+  return p1.x + s1.x * 0.5f > p2.x - s2.x * 0.5f &&
+         p1.x - s1.x * 0.5f < p2.x + s2.x * 0.5f &&
+         p1.y + s1.y * 0.5f > p2.y - s2.y * 0.5f &&
+         p1.y - s1.y * 0.5f < p2.y + s2.y * 0.5f;
+}
+
+static void
+invaders_find_edges(void) {
+  left_invader  = 0;
+  right_invader = 0;
+  for (u32 i = 0; i < array_list_size(invaders); i++) {
+    if (invaders[i].x < invaders[left_invader].x)  left_invader  = i;
+    if (invaders[i].x > invaders[right_invader].x) right_invader = i;
+  }
+}
+
+void
+__conf(blib_config *config) {
+  config->window_title   = "STRESS: SPACE INVADERS";
+  config->game_width     = GAME_W;
+  config->game_height    = GAME_H;
+  config->quads_capacity = 50000;
+  config->frame_stats    = true;
+}
+
+void
+__init(void) {
+  asset_load(ASSET_ATLAS, STR("invaders"));
+  texture_atlas_setup(STR("invaders"), 8, 8, 0, 0);
+  enable_vsync(false);
+
+  player_bullets = array_list_create(sizeof (v2f));
+  invaders       = array_list_create(sizeof (v2f));
+
+  /* the fleet grows upwards out of the screen */
+  for (u32 i = 0; i < STRESS_INVADERS; i++) {
+    v2f position = {
+      GAME_LEFT + TILE_SIZE * 2 + (i % FLEET_COLUMNS) * (TILE_SIZE * 2 + FLEET_SPACING),
+      GAME_TOP  - TILE_SIZE * 2 + (i / FLEET_COLUMNS) * (TILE_SIZE + FLEET_SPACING)
+    };
+    array_list_push(invaders, position);
+  }
+  invaders_find_edges();
+
+  player_position = V2F(0, GAME_BOTTOM + TILE_SIZE * 2);
+  player_dir      = 1;
+  invaders_dir    = 1;
+  invaders_speed  = 10;
+}
+
+void
+__loop(f32 dt) {
+  if (++frames >= STRESS_FRAMES || array_list_size(invaders) == 0) close_window();
+
+  /* Scripted player: bounces between the walls shooting */
+  player_position.x += dt * PLAYER_SPEED * player_dir;
+  if (player_position.x > GAME_RIGHT - TILE_SIZE) player_dir = -1;
+  if (player_position.x < GAME_LEFT  + TILE_SIZE) player_dir = +1;
+  if (array_list_size(player_bullets) < STRESS_BULLETS) {
+    array_list_push(player_bullets, V2F(player_position.x, player_position.y + TILE_SIZE));
+  }
+
+  /* Move bullets */
+  for (u32 i = array_list_size(player_bullets) - 1; i < (u32)-1; i--) {
+    player_bullets[i].y += dt * BULLET_SPEED;
+    if (player_bullets[i].y - BULLET_SIZE.y * 0.5f > GAME_TOP) array_list_swap_remove(player_bullets, i, 0);
+  }
+
+  /* Move invaders */
+  invaders_timer += dt;
+  f32 invaders_velocity = dt * invaders_speed * invaders_dir;
+  if (invaders[left_invader].x  + invaders_velocity - TILE_SIZE < GAME_LEFT ||
+      invaders[right_invader].x + invaders_velocity + TILE_SIZE > GAME_RIGHT) {
+    invaders_velocity *= -1;
+    invaders_dir *= -1;
+    for (u32 i = 0; i < array_list_size(invaders); i++) {
+      invaders[i].y -= TILE_SIZE * 0.25f;
+    }
+  }
+  for (u32 i = 0; i < array_list_size(invaders); i++) {
+    invaders[i].x += invaders_velocity;
+  }
+
+  /* Shoot invaders */
+  b8 killed = false;
+  for (u32 j = array_list_size(player_bullets) - 1; j < (u32)-1; j--) {
+    for (u32 i = array_list_size(invaders) - 1; i < (u32)-1; i--) {
+      if (!collided(invaders[i], V2F(TILE_SIZE * 2 - 4, TILE_SIZE), player_bullets[j], BULLET_SIZE)) {
+        continue;
+      }
+      array_list_swap_remove(invaders, i, 0);
+      array_list_swap_remove(player_bullets, j, 0);
+      killed = true;
+      break;
+    }
+  }
+  if (killed && array_list_size(invaders) > 0) invaders_find_edges();
+}
+
+void
+__tick(f32 dt) {
+  (void)dt;
+}
+
+void
+__draw(batch *batch) {
+  batch->atlas = STR("invaders");
+
+  clear_screen(COL_BLACK);
+
+  /* Draw invaders */
+  for (u32 i = 0; i < array_list_size(invaders); i++) {
+    draw_tile(V2U(1 + (u32)(invaders_timer * INVADERS_ANIM_SPEED) % 2, 0),
+        v2f_add(invaders[i], V2F(-TILE_SIZE*0.5f, 0)), V2F(+1, 1), V2F_0, 0, COL_WHITE, 0);
+    draw_tile(V2U(1 + (u32)(invaders_timer * INVADERS_ANIM_SPEED) % 2, 0),
+        v2f_add(invaders[i], V2F(+TILE_SIZE*0.5f, 0)), V2F(-1, 1), V2F_0, 0, COL_WHITE, 0);
+  }
+
+  /* Draw player */
+  draw_tile(V2U(0, 0),
+      v2f_add(player_position, V2F(-TILE_SIZE*0.5f, 0)), V2F(+1, 1), V2F_0, 0, COL_WHITE, 0);
+  draw_tile(V2U(0, 0),
+      v2f_add(player_position, V2F(+TILE_SIZE*0.5f, 0)), V2F(-1, 1), V2F_0, 0, COL_WHITE, 0);
+
+  for (u32 i = 0; i < array_list_size(player_bullets); i++) {
+    draw_rect(player_bullets[i], BULLET_SIZE, V2F_0, 0, COL_WHITE, 0);
+  }
+
+  draw_text(V2F(GAME_LEFT + 8, GAME_BOTTOM + 8), V2F(1, 1), COL_WHITE, 1,
+      STR("INVADERS: %u"), array_list_size(invaders));
+
+  submit_batch();
+}
+
+void
+__quit(void) {
+  array_list_destroy(player_bullets);
+  array_list_destroy(invaders);
+}
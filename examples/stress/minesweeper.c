@@ -0,0 +1,180 @@
+/*
+ * Minesweeper stress scene.
+ *
+ * A scripted session of minesweeper on a huge board: every frame a few
+ * random cells are flagged or opened (flood filling the empty areas) and
+ * the whole board is drawn. Runs for STRESS_FRAMES frames then closes and
+ * reports the frame time percentiles.
+ *
+ * Parameters (compile with -DNAME=VALUE):
+ *   STRESS_BOARD_SIZE   board width and height in cells
+ *   STRESS_MINES        mines per 100 cells
+ *   STRESS_CLICKS       cells clicked every frame
+ *   STRESS_FRAMES       session length in frames
+ * */
+
+#include <blib.h>
+
+#ifndef STRESS_BOARD_SIZE
+#define STRESS_BOARD_SIZE 2000
+#endif
+
+#ifndef STRESS_MINES
+#define STRESS_MINES 15
+#endif
+
+#ifndef STRESS_CLICKS
+#define STRESS_CLICKS 16
+#endif
+
+#ifndef STRESS_FRAMES
+#define STRESS_FRAMES 600
+#endif
+
+#define CELL_SIZE 8
+
+#define BOARD_SIZE STRESS_BOARD_SIZE
+
+#define GAME_W 960
+#define GAME_H 720
+
+#define BOARD_LEFT   (-BOARD_SIZE * CELL_SIZE * 0.5f)
+#define BOARD_BOTTOM (-BOARD_SIZE * CELL_SIZE * 0.5f)
+
+typedef struct {
+  u32 mines_around;
+  b8  placed_flag;
+  b8  is_mine;
+  b8  is_open;
+} cell;
+
+static cell *board;
+#define BOARD(X, Y) board[(Y) * BOARD_SIZE + (X)]
+
+/* cells waiting to be opened by the flood fill */
+static v2i *open_stack;
+
+static u32 frames;
+
+void
+__conf(blib_config *config) {
+  config->window_title   = "STRESS: MINESWEEPER";
+  config->game_width     = GAME_W;
+  config->game_height    = GAME_H;
+  config->quads_capacity = 50000;
+  config->frame_stats    = true;
+}
+
+static void
+generate_mines(void) {
+  for (s32 y = 0; y < BOARD_SIZE; y++) {
+    for (s32 x = 0; x < BOARD_SIZE; x++) {
+      BOARD(x, y).is_mine = (u32)(rand() % 100) < STRESS_MINES;
+    }
+  }
+  for (s32 y = 0; y < BOARD_SIZE; y++) {
+    for (s32 x = 0; x < BOARD_SIZE; x++) {
+      if (BOARD(x, y).is_mine) continue;
+      for (s32 i = -1; i <= 1; i++) {
+        for (s32 j = -1; j <= 1; j++) {
+          if (x + j < 0 || x + j >= BOARD_SIZE || y + i < 0 || y + i >= BOARD_SIZE) continue;
+          BOARD(x, y).mines_around += BOARD(x + j, y + i).is_mine;
+        }
+      }
+    }
+  }
+}
+
+/* Same rules as the game's `open_cell()`, with an explicit stack since
+ * the recursion can't handle flood fills this big. */
+static void
+open_cell(s32 x, s32 y) {
+  array_list_push(open_stack, V2I(x, y));
+  while (array_list_size(open_stack) > 0) {
+    v2i c;
+    array_list_pop(open_stack, &c);
+    if (c.x < 0 || c.x > BOARD_SIZE - 1 || c.y < 0 || c.y > BOARD_SIZE - 1) continue;
+    cell *cell = &BOARD(c.x, c.y);
+    if (cell->is_open || cell->is_mine) continue;
+    cell->is_open = true;
+    if (cell->mines_around > 0) continue;
+    for (s32 i = -1; i <= 1; i++) {
+      for (s32 j = -1; j <= 1; j++) {
+        if (i == 0 && j == 0) continue;
+        array_list_push(open_stack, V2I(c.x + j, c.y + i));
+      }
+    }
+  }
+}
+
+void
+__init(void) {
+  asset_load(ASSET_ATLAS, STR("minesweeper"));
+  texture_atlas_setup(STR("minesweeper"), CELL_SIZE, CELL_SIZE, 0, 0);
+  enable_vsync(false);
+
+  board      = calloc(BOARD_SIZE * BOARD_SIZE, sizeof (cell));
+  open_stack = array_list_create(sizeof (v2i));
+  generate_mines();
+}
+
+void
+__loop(f32 dt) {
+  (void)dt;
+  if (++frames >= STRESS_FRAMES) close_window();
+
+  /* Scripted player: clicks random cells, flagging the mines */
+  for (u32 i = 0; i < STRESS_CLICKS; i++) {
+    s32 x = rand() % BOARD_SIZE;
+    s32 y = rand() % BOARD_SIZE;
+    if (BOARD(x, y).is_mine) {
+      BOARD(x, y).placed_flag = true;
+    } else {
+      open_cell(x, y);
+    }
+  }
+
+  /* Scroll the camera through the board */
+  v2f camera = camera_get_position();
+  camera.x += 4;
+  if (camera.x > -BOARD_LEFT) {
+    camera.x = BOARD_LEFT;
+    camera.y += GAME_H;
+    if (camera.y > -BOARD_BOTTOM) camera.y = BOARD_BOTTOM;
+  }
+  camera_set_position(camera);
+}
+
+void
+__tick(f32 dt) {
+  (void)dt;
+}
+
+void
+__draw(batch *batch) {
+  batch->atlas = STR("minesweeper");
+  clear_screen(COL_GRAY);
+  for (s32 y = 0; y < BOARD_SIZE; y++) {
+    for (s32 x = 0; x < BOARD_SIZE; x++) {
+      cell *cell = &BOARD(x, y);
+      v2f pos = {
+        .x = BOARD_LEFT   + x * CELL_SIZE + CELL_SIZE * 0.5f,
+        .y = BOARD_BOTTOM + y * CELL_SIZE + CELL_SIZE * 0.5f
+      };
+      if (!cell->is_open) {
+        draw_tile(V2U(cell->placed_flag, 0), pos, V2F(1, 1), V2F_0, 0, COL_WHITE, 0);
+      } else if (cell->is_mine) {
+        draw_tile(V2U(3, 0), pos, V2F(1, 1), V2F_0, 0, COL_WHITE, 0);
+      } else {
+        draw_tile(V2U(2, 0), pos, V2F(1, 1), V2F_0, 0, COL_WHITE, 0);
+      }
+    }
+  }
+  submit_batch();
+}
+
+void
+__quit(void) {
+  free(board);
+  array_list_destroy(open_stack);
+}
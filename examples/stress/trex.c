@@ -0,0 +1,235 @@
+/*
+ * T-Rex stress scene.
+ *
+ * A scripted session of the t-rex game with a crowd of movable entities:
+ * clouds and cacti are spawned every frame until there are STRESS_MOVABLES
+ * of them, the ones leaving the screen are destroyed and the dino jumps
+ * on its own. Runs for STRESS_FRAMES frames then closes and reports the
+ * frame time percentiles.
+ *
+ * Parameters (compile with -DNAME=VALUE):
+ *   STRESS_MOVABLES   max movable entities alive at the same time
+ *   STRESS_SPAWN      movables spawned every frame
+ *   STRESS_FRAMES     session length in frames
+ * */
+
+#include <blib.h>
+
+#ifndef STRESS_MOVABLES
+#define STRESS_MOVABLES 100000
+#endif
+
+#ifndef STRESS_SPAWN
+#define STRESS_SPAWN 1000
+#endif
+
+#ifndef STRESS_FRAMES
+#define STRESS_FRAMES 600
+#endif
+
+typedef struct {
+  f32 top,
+      left,
+      bottom,
+      right;
+} collider;
+
+#define GAME_W 480
+#define GAME_H 270
+
+#define TILE_SIZE V2F(16, 16)
+
+#define GROUND_Y -TILE_SIZE.y * 0.5f
+
+/* the ids of the entity types and their components, kept since `__init` */
+static entity_type_id dino_type;
+static struct {
+  component_id position, velocity_y, on_ground, tile, collider;
+} dino_comps;
+
+static entity_type_id movable_type;
+static struct {
+  component_id position, velocity_x, can_hit, tile, collider;
+} movable_comps;
+
+static entity dino;
+#define DINO_GRAVITY -0.25f
+#define DINO_MAX_GRAVITY -10
+#define DINO_JUMP_HEIGHT 3.75f
+#define DINO_COLLIDER_SIZE V2F(8, 14)
+
+#define CACTUS_COLLIDER_SIZE V2F(6, 16)
+
+static f32 game_time;
+static u32 hits;
+static u32 frames;
+
+static void
+collider_update(collider *col, v2f pos, v2f siz) {
+  col->top    = pos.y + siz.y * 0.5f;
+  col->bottom = pos.y - siz.y * 0.5f;
+
+  col->right = pos.x + siz.x * 0.5f;
+  col->left  = pos.x - siz.x * 0.5f;
+}
+
+static b8
+collided(collider *c1, collider *c2) {
+  return c1->top    > c2->bottom &&
+         c1->bottom < c2->top    &&
+         c1->right  > c2->left   &&
+         c1->left   < c2->right;
+}
+
+void
+__conf(blib_config *config) {
+  config->window_title   = "STRESS: T-REX GAME";
+  config->game_width     = GAME_W;
+  config->game_height    = GAME_H;
+  config->game_scale     = 2;
+  config->quads_capacity = 50000;
+  config->frame_stats    = true;
+}
+
+void
+__init(void) {
+  asset_load(ASSET_ATLAS, STR("trexgame"));
+  enable_vsync(false);
+
+  dino_type = entity_type_begin(STR("dino"));
+    dino_comps.position   = entity_type_add_component(STR("position"),   sizeof (v2f));
+    dino_comps.velocity_y = entity_type_add_component(STR("velocity_y"), sizeof (f32));
+    dino_comps.on_ground  = entity_type_add_component(STR("on_ground"),  sizeof (b8));
+    dino_comps.tile       = entity_type_add_component(STR("tile"),       sizeof (v2u));
+    dino_comps.collider   = entity_type_add_component(STR("collider"),   sizeof (collider));
+  entity_type_end();
+
+  movable_type = entity_type_begin(STR("movable"));
+    movable_comps.position   = entity_type_add_component(STR("position"),   sizeof (v2f));
+    movable_comps.velocity_x = entity_type_add_component(STR("velocity_x"), sizeof (f32));
+    movable_comps.can_hit    = entity_type_add_component(STR("can_hit"),    sizeof (b8));
+    movable_comps.tile       = entity_type_add_component(STR("tile"),       sizeof (v2u));
+    movable_comps.collider   = entity_type_add_component(STR("collider"),   sizeof (collider));
+  entity_type_end();
+
+  entity_type_reserve(STR("movable"), STRESS_MOVABLES);
+
+  entity_create_id(dino_type, &dino);
+  v2f *dino_pos = entity_get_component_id(&dino, dino_comps.position);
+  dino_pos->x = -GAME_W * 0.5f + TILE_SIZE.x;
+  dino_pos->y = GROUND_Y;
+  *(f32 *)entity_get_component_id(&dino, dino_comps.velocity_y) = 0;
+  *(v2u *)entity_get_component_id(&dino, dino_comps.tile)       = V2U(0, 0);
+}
+
+void
+__loop(f32 dt) {
+  if (++frames >= STRESS_FRAMES) close_window();
+  game_time += dt;
+
+  /* Create movables */
+  u32 movables = array_list_size(entity_type_get_components_id(movable_type, movable_comps.position));
+  for (u32 i = 0; i < STRESS_SPAWN && movables + i < STRESS_MOVABLES; i++) {
+    entity movable;
+    entity_create_id(movable_type, &movable);
+    b8 is_cactus = rand() % 2;
+    v2f *pos = entity_get_component_id(&movable, movable_comps.position);
+    pos->x = GAME_W * 0.5f + TILE_SIZE.x + (rand() % GAME_W);
+    pos->y = is_cactus ? GROUND_Y : (rand() % (u32)(GAME_H * 0.4f));
+    *(f32 *)entity_get_component_id(&movable, movable_comps.velocity_x) = 1 + (rand() % 3);
+    *(b8  *)entity_get_component_id(&movable, movable_comps.can_hit)    = is_cactus;
+    *(v2u *)entity_get_component_id(&movable, movable_comps.tile)       = is_cactus ? V2U(0, 5 + (rand() % 2)) : V2U(0, 7);
+    collider_update(entity_get_component_id(&movable, movable_comps.collider), *pos, CACTUS_COLLIDER_SIZE);
+  }
+
+  /* Update dino tile */
+  v2u *dino_tile      = entity_get_component_id(&dino, dino_comps.tile);
+  b8  *dino_on_ground = entity_get_component_id(&dino, dino_comps.on_ground);
+  dino_tile->y = *dino_on_ground ? 1 + (u32)(game_time * 8) % 2 : 0;
+
+  /* Update dino collider */
+  v2f *dino_pos = entity_get_component_id(&dino, dino_comps.position);
+  collider *dino_col = entity_get_component_id(&dino, dino_comps.collider);
+  collider_update(dino_col, *dino_pos, DINO_COLLIDER_SIZE);
+
+  /* Update movable colliders */
+  v2f      *mov_positions = entity_type_get_components_id(movable_type, movable_comps.position);
+  b8       *mov_can_hits  = entity_type_get_components_id(movable_type, movable_comps.can_hit);
+  collider *mov_colliders = entity_type_get_components_id(movable_type, movable_comps.collider);
+
+  for (u32 i = 0; i < array_list_size(mov_positions); i++) {
+    if (!mov_can_hits[i]) continue;
+    collider_update(&mov_colliders[i], mov_positions[i], CACTUS_COLLIDER_SIZE);
+  }
+
+  /* Dino hits, the session goes on */
+  for (u32 i = 0; i < array_list_size(mov_colliders); i++) {
+    if (!mov_can_hits[i]) continue;
+    if (collided(dino_col, &mov_colliders[i])) hits++;
+  }
+}
+
+void
+__tick(f32 dt) {
+  (void)dt;
+
+  /* Update dino, it jumps whenever it lands */
+  v2f *dino_position   = entity_get_component_id(&dino, dino_comps.position);
+  f32 *dino_velocity_y = entity_get_component_id(&dino, dino_comps.velocity_y);
+  b8  *dino_on_ground  = entity_get_component_id(&dino, dino_comps.on_ground);
+
+  *dino_on_ground = dino_position->y <= GROUND_Y;
+
+  *dino_velocity_y += DINO_GRAVITY;
+  if (*dino_velocity_y < DINO_MAX_GRAVITY) *dino_velocity_y = DINO_MAX_GRAVITY;
+
+  if (*dino_on_ground) *dino_velocity_y = DINO_JUMP_HEIGHT;
+
+  dino_position->y += *dino_velocity_y;
+  if (dino_position->y < GROUND_Y) {
+    dino_position->y = GROUND_Y;
+  }
+
+  /* Move movables, destroying the ones that left the screen */
+  v2f *mov_positions    = entity_type_get_components_id(movable_type, movable_comps.position);
+  f32 *mov_velocities_x = entity_type_get_components_id(movable_type, movable_comps.velocity_x);
+
+  for (u32 i = array_list_size(mov_positions) - 1; i < (u32)-1; i--) {
+    mov_positions[i].x -= mov_velocities_x[i];
+    if (mov_positions[i].x < -GAME_W * 0.5f - TILE_SIZE.x) {
+      entity_destroy_by_index_id(movable_type, i);
+    }
+  }
+}
+
+void
+__draw(batch *batch) {
+  clear_screen(COL_WHITE);
+
+  batch->atlas = STR("trexgame");
+
+  /* Draw Dino */
+  v2f *dino_position = entity_get_component_id(&dino, dino_comps.position);
+  v2u *dino_tile     = entity_get_component_id(&dino, dino_comps.tile);
+  draw_tile(*dino_tile, *dino_position, V2F(1, 1), V2F_0, 0, COL_WHITE, 0);
+
+  draw_rect(V2F(0, -TILE_SIZE.y), V2F(GAME_W, 1),
+      V2F_0, 0,
+      V4F(0.27f, 0.15f, 0.23f, 1.00f), 0);
+
+  /* Draw movables */
+  v2f *mov_positions = entity_type_get_components_id(movable_type, movable_comps.position);
+  v2u *mov_tiles     = entity_type_get_components_id(movable_type, movable_comps.tile);
+
+  for (u32 i = 0; i < array_list_size(mov_positions); i++) {
+    draw_tile(mov_tiles[i], mov_positions[i], V2F(1, 1), V2F_0, 0, COL_WHITE, 0);
+  }
+
+  draw_text(V2F(-GAME_W * 0.5f + 8, GAME_H * 0.5f - 8), V2F(1, 1), COL_BLACK, 1,
+      STR("MOVABLES: %u HITS: %u"), array_list_size(mov_positions), hits);
+  submit_batch();
+}
+
+void
+__quit(void) {
+}
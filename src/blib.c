@@ -1,4 +1,8 @@
+/* for nanosleep */
+#define _POSIX_C_SOURCE 199309L
+
 #include "blib.h"
+#include "blib_internal.h"
 
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
@@ -11,6 +15,11 @@
 #include <stdarg.h>
 
 #include <time.h>
+#include <pthread.h>
+
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
 
 #ifdef __linux
 #include <uuid/uuid.h>
@@ -28,6 +37,31 @@
  * ****************************
  */
 
+/*
+ * Memory
+ */
+
+static struct {
+  const blib_allocator *allocator; /* NULL until `blib_config.allocator` is set */
+  pool                 *strings;   /* the buffers of small strings, created on first use */
+  region               *region;    /* the open region, containers created meanwhile use it */
+#ifdef BLIB_MEMORY_STATS
+  memory_stats          stats[MEMORY_TAGS_AMOUNT];
+  u64                   frame_allocs[MEMORY_TAGS_AMOUNT]; /* of the current frame */
+  u32                   frames;        /* frames the main loop started */
+  u32                   warmup_frames; /* `blib_config.memory_warmup_frames` */
+  b8                    in_frame;      /* between `__loop` and the buffer swap */
+#endif
+} memory;
+
+/* Two arenas, the current frame allocates from `arenas[current]` while the
+ * other one keeps what the previous frame allocated. */
+static struct {
+  arena *arenas[2];
+  u32    current;
+  u64    size;
+} frame_arena;
+
 /*
  * Camera
  */
@@ -62,6 +96,56 @@ static struct {
   } keyboard;
 } input;
 
+/*
+ * Input Recording
+ */
+
+#define INPUT_RECORD_MAGIC   0x50524c42 /* "BLRP" */
+#define INPUT_RECORD_VERSION 1
+
+typedef enum {
+  INPUT_RECORD_NONE = 0,
+  INPUT_RECORD_WRITE,
+  INPUT_RECORD_REPLAY
+} input_record_mode;
+
+typedef struct {
+  u32 magic;
+  u32 version;
+  u32 seed;
+} input_record_header;
+
+/* One snapshot of the input state, taken at the start of every frame. */
+typedef struct {
+  f32 dt;
+  v2f screen_position;
+  v2f scroll;
+  b8  keys_cur[KEY_CAP];
+  b8  buttons_cur[BTN_CAP];
+} input_record_frame;
+
+static struct {
+  input_record_mode mode;
+  ccstr path;
+  FILE *file;
+  u32 seed;
+  b8  fast;
+  b8  headless;
+  u64 frames;
+  u64 ticks;
+} input_record;
+
+/*
+ * Frame Stats
+ */
+
+static struct {
+  b8            enabled;
+  u32           frames;
+  u32           frames_limit;
+  segment_list *times;
+} frame_stats;
+
 /*
  * *** Rendering ***
  */
@@ -77,6 +161,10 @@ typedef vertex trig[3];
 
 static struct {
   batch batch;
+  /* the atoms of the batch names, see batch_name_atom() */
+  atom batch_shaders[BATCH_SHADERS_AMOUNT];
+  atom batch_atlas;
+  atom batch_font;
   u32 layers_amount;
 
   u32 quads_amount;
@@ -84,6 +172,7 @@ static struct {
   u32 quads_indices_capa;
   vertex *quads_vertices;
   quad ***quads_requests;
+  b8 *layers_sort_by_y;
   u32 quads_vao;
   u32 quads_vbo;
   u32 quads_ibo;
@@ -105,20 +194,24 @@ static struct {
 typedef struct {
   void *list;
   u32   type;
+  atom  name;
 } entity_component;
 
 typedef struct {
-  str *component_names;
-  hash_table *components;
+  entity_component *components; /* indexed by component id */
+  hash_table *component_ids;    /* keyed by the atoms of the component names */
   u128 *indexes_ids;
   hash_table *indexes;
   u32 amount;
-  u32 name_index;
+  atom name;      /* ATOM_NONE while the slot is free */
+  u32 generation; /* counts the types that had the slot, it's part of their ids */
+  region *region; /* the region it was created in, if any */
+  const blib_allocator *allocator; /* the one of that region, every component list comes from it */
 } entity_type;
 
 static struct {
-  str *entity_type_names;
-  hash_table *entities;
+  entity_type *types;   /* indexed by entity type id, destroyed types leave their slot free */
+  hash_table *entities; /* the entity type ids, keyed by the atoms of the type names */
   entity_type *new_type;
 } entity_system;
 
@@ -135,16 +228,621 @@ static struct {
  * ****************************
  */
 
+/*
+ * *** Memory ***
+ * */
+
+/* The default allocator over-allocates to align the pointer it returns and keeps
+ * the one malloc gave it right before. */
+static void *
+default_alloc(void *ctx, u64 size, u32 align) {
+  (void)ctx;
+  align = MAX(align, sizeof (void *));
+  u8 *raw = malloc(size + align - 1 + sizeof (void *));
+  if (!raw) return 0;
+  u8 *ptr = (u8 *)ALIGN_UP((uintptr_t)raw + sizeof (void *), align);
+  ((void **)ptr)[-1] = raw;
+  return ptr;
+}
+
+static void *
+default_resize(void *ctx, void *ptr, u64 old_size, u64 size, u32 align) {
+  (void)ctx;
+  align = MAX(align, sizeof (void *));
+  u8 *old_raw = ((void **)ptr)[-1];
+  u64 offset  = (u8 *)ptr - old_raw;
+  u8 *raw = realloc(old_raw, size + align - 1 + sizeof (void *));
+  if (!raw) return 0;
+  u8 *new_ptr = (u8 *)ALIGN_UP((uintptr_t)raw + sizeof (void *), align);
+  /* realloc keeps the bytes where they were, not the alignment */
+  if ((u64)(new_ptr - raw) != offset) memmove(new_ptr, raw + offset, MIN(old_size, size));
+  ((void **)new_ptr)[-1] = raw;
+  return new_ptr;
+}
+
+static void
+default_release(void *ctx, void *ptr, u64 size) {
+  (void)ctx;
+  (void)size;
+  if (ptr) free(((void **)ptr)[-1]);
+}
+
+const blib_allocator blib_default_allocator = {
+  .alloc   = default_alloc,
+  .resize  = default_resize,
+  .release = default_release,
+  .ctx     = 0
+};
+
+/* The allocator of the library ignoring regions, for what the engine keeps until exit. */
+static const blib_allocator *
+memory_base_allocator(void) {
+  return memory.allocator ? memory.allocator : &blib_default_allocator;
+}
+
+static const blib_allocator *region_allocator(region *region);
+
+const blib_allocator *
+blib_get_allocator(void) {
+  return memory.region ? region_allocator(memory.region) : memory_base_allocator();
+}
+
+/* The frames the main loop may allocate in before BLIB_MEMORY_STATS flags it. */
+#define MEMORY_WARMUP_DEFAULT_FRAMES 60
+
+static const ccstr memory_tag_names[MEMORY_TAGS_AMOUNT] = {
+  [MEMORY_TAG_OTHER]           = "other",
+  [MEMORY_TAG_STRINGS]         = "strings",
+  [MEMORY_TAG_ARRAY_LISTS]     = "array lists",
+  [MEMORY_TAG_HASH_TABLES]     = "hash tables",
+  [MEMORY_TAG_ENTITY_SYSTEM]   = "entity system",
+  [MEMORY_TAG_RENDERER]        = "renderer",
+  [MEMORY_TAG_ASSETS]          = "assets",
+  [MEMORY_TAG_TEXTURE_BUFFERS] = "texture buffers",
+  [MEMORY_TAG_ARENAS]          = "arenas",
+};
+
+#ifdef BLIB_MEMORY_STATS
+static void *arena_hook_alloc(void *ctx, u64 size, u32 align);
+static void *pool_hook_alloc(void *ctx, u64 size, u32 align);
+
+/* What arenas and pools hand out was already counted as their blocks. */
+#define MEMORY_COUNTED(ALLOCATOR) ((ALLOCATOR)->alloc != arena_hook_alloc && (ALLOCATOR)->alloc != pool_hook_alloc)
+
+static void
+memory_count_alloc(memory_tag tag, u64 old_size, u64 size) {
+  memory_stats *stats = &memory.stats[tag];
+  stats->live_bytes = stats->live_bytes - old_size + size;
+  stats->peak_bytes = MAX(stats->peak_bytes, stats->live_bytes);
+  stats->allocs++;
+  memory.frame_allocs[tag]++;
+  if (memory.frames) stats->loop_allocs++;
+  if (memory.in_frame && memory.frames > memory.warmup_frames) {
+    if (!stats->hot_allocs) {
+      wrn("memory: %s allocated %lu bytes between __loop and the buffer swap on frame %u\n",
+          memory_tag_names[tag], (unsigned long)size, memory.frames);
+    }
+    stats->hot_allocs++;
+  }
+}
+
+static void
+memory_count_free(memory_tag tag, u64 size) {
+  memory.stats[tag].live_bytes -= size;
+  memory.stats[tag].frees++;
+}
+#endif
+
+static inline void *
+memory_alloc(const blib_allocator *allocator, memory_tag tag, u64 size, u32 align) {
+#ifdef BLIB_MEMORY_STATS
+  if (MEMORY_COUNTED(allocator)) memory_count_alloc(tag, 0, size);
+#else
+  (void)tag;
+#endif
+  return allocator->alloc(allocator->ctx, size, align);
+}
+
+static inline void *
+memory_realloc(const blib_allocator *allocator, memory_tag tag, void *ptr, u64 old_size, u64 size, u32 align) {
+#ifdef BLIB_MEMORY_STATS
+  if (MEMORY_COUNTED(allocator)) memory_count_alloc(tag, old_size, size);
+#else
+  (void)tag;
+#endif
+  return allocator->resize(allocator->ctx, ptr, old_size, size, align);
+}
+
+static inline void
+memory_free(const blib_allocator *allocator, memory_tag tag, void *ptr, u64 size) {
+#ifdef BLIB_MEMORY_STATS
+  if (ptr && MEMORY_COUNTED(allocator)) memory_count_free(tag, size);
+#else
+  (void)tag;
+#endif
+  allocator->release(allocator->ctx, ptr, size);
+}
+
+/* Called by the main loop before `__loop`, allocating from now on is on the hot path. */
+static void
+memory_frame_begin(void) {
+#ifdef BLIB_MEMORY_STATS
+  memory.frames++;
+  memory.in_frame = true;
+#endif
+}
+
+/* Called by the main loop once the frame is on the screen. */
+static void
+memory_frame_end(void) {
+#ifdef BLIB_MEMORY_STATS
+  memory.in_frame = false;
+  for (u32 i = 0; i < MEMORY_TAGS_AMOUNT; i++) {
+    memory.stats[i].frame_allocs = memory.frame_allocs[i];
+    memory.frame_allocs[i] = 0;
+  }
+#endif
+}
+
+memory_stats
+memory_get_stats(memory_tag tag) {
+  memory_stats stats = { 0 };
+  if (tag >= MEMORY_TAGS_AMOUNT) {
+    wrn("memory_get_stats(): invalid tag '%u'\n", tag);
+    return stats;
+  }
+#ifdef BLIB_MEMORY_STATS
+  stats = memory.stats[tag];
+#endif
+  return stats;
+}
+
+ccstr
+memory_tag_name(memory_tag tag) {
+  return tag < MEMORY_TAGS_AMOUNT ? memory_tag_names[tag] : "invalid";
+}
+
+void
+memory_stats_dump(void) {
+  for (u32 i = 0; i < MEMORY_TAGS_AMOUNT; i++) {
+    memory_stats stats = memory_get_stats(i);
+#ifdef BLIB_MEMORY_STATS
+    f64 per_frame = memory.frames ? (f64)stats.loop_allocs / memory.frames : 0;
+#else
+    f64 per_frame = 0;
+#endif
+    inf("memory '%s': live %lu bytes, peak %lu bytes, allocs %lu, frees %lu, %.2f allocs per frame, %lu on the hot path\n",
+        memory_tag_names[i], (unsigned long)stats.live_bytes, (unsigned long)stats.peak_bytes,
+        (unsigned long)stats.allocs, (unsigned long)stats.frees, per_frame, (unsigned long)stats.hot_allocs);
+  }
+}
+
+/*
+ * *** Arena ***
+ * */
+
+/* The size of the frame arenas when `blib_config.frame_arena_size` is 0. */
+#define FRAME_ARENA_DEFAULT_SIZE (256 * 1024)
+
+/* A block of an arena, its bytes start ARENA_BLOCK_HEADER bytes in. */
+typedef struct arena_block {
+  struct arena_block *prev;
+  u64                 capa;
+  u64                 used;
+} arena_block;
+#define ARENA_BLOCK_HEADER ALIGN_UP(sizeof (arena_block), BLIB_ALIGN)
+#define ARENA_BLOCK_DATA(BLOCK) ((u8 *)(BLOCK) + ARENA_BLOCK_HEADER)
+
+struct arena {
+  blib_allocator        hooks; /* the arena as an allocator */
+  const blib_allocator *allocator;
+  memory_tag            tag;
+  arena_block          *block;
+  u64                   used;
+  u64                   peak;
+  void                 *last; /* the last allocation, the only one that can grow or shrink in place */
+  u64                   mark; /* the used bytes of the block before the last allocation and its padding */
+};
+
+static arena_block *
+arena_block_create(arena *arena, u64 capa, arena_block *prev) {
+  arena_block *block = memory_alloc(arena->allocator, arena->tag, ARENA_BLOCK_HEADER + capa, BLIB_ALIGN);
+  block->prev = prev;
+  block->capa = capa;
+  block->used = 0;
+  return block;
+}
+
+void *
+arena_alloc(arena *arena, u64 size, u32 align) {
+  arena_block *block = arena->block;
+  uintptr_t start = (uintptr_t)ARENA_BLOCK_DATA(block);
+  uintptr_t ptr   = ALIGN_UP(start + block->used, align);
+  if (ptr + size > start + block->capa) {
+    block = arena->block = arena_block_create(arena, MAX(block->capa * 2, size + align), block);
+    start = (uintptr_t)ARENA_BLOCK_DATA(block);
+    ptr   = ALIGN_UP(start, align);
+  }
+  arena->mark  = block->used;
+  arena->used += ptr + size - (start + block->used);
+  arena->peak  = MAX(arena->peak, arena->used);
+  block->used  = ptr + size - start;
+  arena->last  = (void *)ptr;
+  return arena->last;
+}
+
+static void *
+arena_hook_alloc(void *ctx, u64 size, u32 align) {
+  return arena_alloc(ctx, size, align);
+}
+
+static void *
+arena_hook_resize(void *ctx, void *ptr, u64 old_size, u64 size, u32 align) {
+  arena *arena = ctx;
+  arena_block *block = arena->block;
+  if (ptr == arena->last && (u8 *)ptr + size <= ARENA_BLOCK_DATA(block) + block->capa) {
+    arena->used += size - old_size;
+    arena->peak  = MAX(arena->peak, arena->used);
+    block->used  = (u8 *)ptr + size - ARENA_BLOCK_DATA(block);
+    return ptr;
+  }
+  void *new_ptr = arena_alloc(arena, size, align);
+  memcpy(new_ptr, ptr, MIN(old_size, size));
+  return new_ptr;
+}
+
+static void
+arena_hook_release(void *ctx, void *ptr, u64 size) {
+  arena *arena = ctx;
+  (void)size;
+  if (ptr != arena->last) return;
+  /* rewinding to the mark also gives back the alignment padding arena_alloc counted */
+  arena->used       -= arena->block->used - arena->mark;
+  arena->block->used = arena->mark;
+  arena->last        = 0;
+}
+
+static arena *
+arena_create_with(u64 capa, const blib_allocator *allocator, memory_tag tag) {
+  arena *arena = memory_alloc(allocator, tag, sizeof (struct arena), BLIB_ALIGN);
+  arena->hooks.alloc   = arena_hook_alloc;
+  arena->hooks.resize  = arena_hook_resize;
+  arena->hooks.release = arena_hook_release;
+  arena->hooks.ctx     = arena;
+  arena->allocator     = allocator;
+  arena->tag           = tag;
+  arena->block         = arena_block_create(arena, MAX(capa, 1), 0);
+  arena->used          = 0;
+  arena->peak          = 0;
+  arena->last          = 0;
+  arena->mark          = 0;
+  return arena;
+}
+
+arena *
+arena_create(u64 capa) {
+  return arena_create_with(capa, blib_get_allocator(), MEMORY_TAG_ARENAS);
+}
+
+void
+arena_reset(arena *arena) {
+  arena_block *block = arena->block;
+  if (block->prev) {
+    /* it grew since the last reset, one block as big as all of them avoids growing again */
+    u64 capa = 0;
+    while (block) {
+      arena_block *prev = block->prev;
+      capa += block->capa;
+      memory_free(arena->allocator, arena->tag, block, ARENA_BLOCK_HEADER + block->capa);
+      block = prev;
+    }
+    arena->block = arena_block_create(arena, capa, 0);
+  }
+  arena->block->used = 0;
+  arena->used        = 0;
+  arena->last        = 0;
+}
+
+u64
+arena_used(arena *arena) {
+  return arena->used;
+}
+
+u64
+arena_peak(arena *arena) {
+  return arena->peak;
+}
+
+const blib_allocator *
+arena_allocator(arena *arena) {
+  return &arena->hooks;
+}
+
+void
+arena_destroy(arena *arena) {
+  arena_block *block = arena->block;
+  while (block) {
+    arena_block *prev = block->prev;
+    memory_free(arena->allocator, arena->tag, block, ARENA_BLOCK_HEADER + block->capa);
+    block = prev;
+  }
+  memory_free(arena->allocator, arena->tag, arena, sizeof (struct arena));
+}
+
+/* Returns the arena of the current frame, the frame arenas are created on first use. */
+static arena *
+frame_arena_get(void) {
+  if (!frame_arena.arenas[0]) {
+    u64 size = frame_arena.size ? frame_arena.size : FRAME_ARENA_DEFAULT_SIZE;
+    frame_arena.arenas[0] = arena_create_with(size, memory_base_allocator(), MEMORY_TAG_ARENAS);
+    frame_arena.arenas[1] = arena_create_with(size, memory_base_allocator(), MEMORY_TAG_ARENAS);
+  }
+  return frame_arena.arenas[frame_arena.current];
+}
+
+/* Called by the main loop once the frame is on the screen, frees the frame before the last one. */
+static void
+frame_arena_swap(void) {
+  if (!frame_arena.arenas[0]) return;
+  frame_arena.current ^= 1;
+  arena_reset(frame_arena.arenas[frame_arena.current]);
+}
+
+void *
+frame_alloc(u64 size, u32 align) {
+  return arena_alloc(frame_arena_get(), size, align);
+}
+
+const blib_allocator *
+frame_allocator(void) {
+  return arena_allocator(frame_arena_get());
+}
+
+/*
+ * *** Pool ***
+ * */
+
+/* Slabs are about this size when `pool_create` isn't given the items per slab. */
+#define POOL_DEFAULT_SLAB_BYTES (16 * 1024)
+
+/* A slab of a pool, its items start POOL_SLAB_HEADER bytes in. */
+typedef struct pool_slab {
+  struct pool_slab *next;
+} pool_slab;
+#define POOL_SLAB_HEADER ALIGN_UP(sizeof (pool_slab), BLIB_ALIGN)
+#define POOL_SLAB_ITEMS(SLAB) ((u8 *)(SLAB) + POOL_SLAB_HEADER)
+
+/*
+ * Freed items are linked through their first bytes. Items that were never
+ * handed out aren't on the free list, they're taken in order from the slabs
+ * starting on `slab`, so a reset only has to rewind to the first slab.
+ */
+struct pool {
+  blib_allocator        hooks; /* the pool as an allocator */
+  const blib_allocator *allocator;
+  memory_tag            tag;
+  pool_slab            *slabs;
+  pool_slab            *slab;  /* the slab new items come from, NULL before the first one */
+  void                 *free;
+  u32                   item_size;
+  u32                   item_align;
+  u32                   slab_items;
+  u32                   next;  /* the next new item of `slab` */
+  u32                   used;
+};
+
+#define POOL_SLAB_BYTES(POOL) (POOL_SLAB_HEADER + (u64)(POOL)->item_size * (POOL)->slab_items)
+
+void *
+pool_alloc(pool *pool) {
+  u8 *item = pool->free;
+  if (item) {
+    pool->free = *(void **)item;
+#ifdef BLIB_POOL_POISON
+    for (u32 i = sizeof (void *); i < pool->item_size; i++) {
+      if (item[i] != POOL_POISON_FREED) {
+        wrn("pool_alloc(): item %p was written after being freed\n", (void *)item);
+        break;
+      }
+    }
+#endif
+  } else {
+    if (!pool->slab || pool->next == pool->slab_items) {
+      pool_slab *next = pool->slab ? pool->slab->next : pool->slabs;
+      if (!next) {
+        next = memory_alloc(pool->allocator, pool->tag, POOL_SLAB_BYTES(pool), BLIB_ALIGN);
+        next->next = 0;
+        if (pool->slab) pool->slab->next = next;
+        else            pool->slabs      = next;
+      }
+      pool->slab = next;
+      pool->next = 0;
+    }
+    item = POOL_SLAB_ITEMS(pool->slab) + (u64)pool->next++ * pool->item_size;
+  }
+#ifdef BLIB_POOL_POISON
+  memset(item, POOL_POISON_ALLOCATED, pool->item_size);
+#endif
+  pool->used++;
+  return item;
+}
+
+void
+pool_free(pool *pool, void *item) {
+  if (!item) return;
+#ifdef BLIB_POOL_POISON
+  memset(item, POOL_POISON_FREED, pool->item_size);
+#endif
+  *(void **)item = pool->free;
+  pool->free = item;
+  pool->used--;
+}
+
+/* The hooks tell pooled memory by its size alone, since `release` gets no alignment. */
+static void *
+pool_hook_alloc(void *ctx, u64 size, u32 align) {
+  pool *pool = ctx;
+  if (size > pool->item_size) return memory_alloc(pool->allocator, pool->tag, size, align);
+  if (align > pool->item_align) {
+    err("pool_allocator(): items of %u bytes can't be aligned to %u\n", pool->item_size, align);
+    exit(1);
+  }
+  return pool_alloc(pool);
+}
+
+static void *
+pool_hook_resize(void *ctx, void *ptr, u64 old_size, u64 size, u32 align) {
+  pool *pool = ctx;
+  b8 old_pooled = old_size <= pool->item_size;
+  b8 new_pooled = size     <= pool->item_size;
+  if (old_pooled && new_pooled) return ptr;
+  if (!old_pooled && !new_pooled) return memory_realloc(pool->allocator, pool->tag, ptr, old_size, size, align);
+  void *new_ptr = pool_hook_alloc(ctx, size, align);
+  memcpy(new_ptr, ptr, MIN(old_size, size));
+  if (old_pooled) pool_free(pool, ptr);
+  else            memory_free(pool->allocator, pool->tag, ptr, old_size);
+  return new_ptr;
+}
+
+static void
+pool_hook_release(void *ctx, void *ptr, u64 size) {
+  pool *pool = ctx;
+  if (size <= pool->item_size) pool_free(pool, ptr);
+  else                         memory_free(pool->allocator, pool->tag, ptr, size);
+}
+
+static pool *
+pool_create_with(u32 item_size, u32 slab_items, const blib_allocator *allocator, memory_tag tag) {
+  pool *pool = memory_alloc(allocator, tag, sizeof (struct pool), BLIB_ALIGN);
+  pool->hooks.alloc   = pool_hook_alloc;
+  pool->hooks.resize  = pool_hook_resize;
+  pool->hooks.release = pool_hook_release;
+  pool->hooks.ctx     = pool;
+  pool->allocator     = allocator;
+  pool->tag           = tag;
+  pool->slabs         = 0;
+  pool->slab          = 0;
+  pool->free          = 0;
+  pool->item_size     = ALIGN_UP(MAX(item_size, sizeof (void *)), item_size < 16 ? 8 : 16);
+  pool->item_align    = MIN(pool->item_size & -pool->item_size, BLIB_ALIGN);
+  pool->slab_items    = slab_items ? slab_items : MAX(POOL_DEFAULT_SLAB_BYTES / pool->item_size, 1);
+  pool->next          = 0;
+  pool->used          = 0;
+  return pool;
+}
+
+pool *
+pool_create(u32 item_size, u32 slab_items) {
+  return pool_create_with(item_size, slab_items, blib_get_allocator(), MEMORY_TAG_ARENAS);
+}
+
+void
+pool_reset(pool *pool) {
+  pool->slab = 0;
+  pool->free = 0;
+  pool->next = 0;
+  pool->used = 0;
+}
+
+u32
+pool_used(pool *pool) {
+  return pool->used;
+}
+
+const blib_allocator *
+pool_allocator(pool *pool) {
+  return &pool->hooks;
+}
+
+void
+pool_destroy(pool *pool) {
+  pool_slab *slab = pool->slabs;
+  while (slab) {
+    pool_slab *next = slab->next;
+    memory_free(pool->allocator, pool->tag, slab, POOL_SLAB_BYTES(pool));
+    slab = next;
+  }
+  memory_free(pool->allocator, pool->tag, pool, sizeof (struct pool));
+}
+
+/*
+ * *** Region ***
+ * */
+
+struct region {
+  arena  *arena;
+  region *prev; /* the region that was open before this one */
+};
+
+static const blib_allocator *
+region_allocator(region *region) {
+  return arena_allocator(region->arena);
+}
+
+region *
+region_create(u64 capa) {
+  region *region = memory_alloc(memory_base_allocator(), MEMORY_TAG_ARENAS, sizeof (struct region), BLIB_ALIGN);
+  region->arena = arena_create_with(capa, memory_base_allocator(), MEMORY_TAG_ARENAS);
+  region->prev  = 0;
+  return region;
+}
+
+void
+region_begin(region *region) {
+  region->prev  = memory.region;
+  memory.region = region;
+}
+
+void
+region_end(void) {
+  if (!memory.region) {
+    wrn("region_end(): there's no open region\n");
+    return;
+  }
+  memory.region = memory.region->prev;
+}
+
+void
+region_reset(region *region) {
+  for (u32 i = 0; i < array_list_size(entity_system.types); i++) {
+    entity_type *type = &entity_system.types[i];
+    if (type->name && type->region == region) entity_type_destroy(atom_str(type->name));
+  }
+  arena_reset(region->arena);
+}
+
+u64
+region_used(region *region) {
+  return arena_used(region->arena);
+}
+
+void
+region_destroy(region *region) {
+  region_reset(region);
+  arena_destroy(region->arena);
+  memory_free(memory_base_allocator(), MEMORY_TAG_ARENAS, region, sizeof (struct region));
+}
+
 /*
  * *** String ***
  * */
 
+/* Strings up to this capacity keep their buffer on the strings pool. */
+#define STRING_POOL_CAPA 32
+
+/* Returns the allocator of the string buffers. */
+static const blib_allocator *
+string_allocator(void) {
+  if (!memory.strings) memory.strings = pool_create_with(STRING_POOL_CAPA, 0, memory_base_allocator(), MEMORY_TAG_STRINGS);
+  return pool_allocator(memory.strings);
+}
+
 str
 string_create(str src) {
   str str;
   str.size = src.size;
   str.capa = str.size + !str.size + (str.size > 0); /* if str.size == 0 then str.capa = 1 else str.capa = str.size + 1 */
-  str.buff = malloc(sizeof (char) * str.capa);
+  str.buff = memory_alloc(string_allocator(), MEMORY_TAG_STRINGS, sizeof (char) * str.capa, 1);
   if (str.size) {
     memcpy(str.buff, src.buff, sizeof (char) * src.size);
     str.buff[src.size] = '\0';
@@ -158,8 +856,19 @@ string_reserve(str *str, u32 amount) {
     wrn("string_reserve(): `str` must have been created by `string_create()`\n");
     return;
   }
+  str->buff = memory_realloc(string_allocator(), MEMORY_TAG_STRINGS, str->buff, str->capa, str->capa + amount + 1, 1);
   str->capa += amount + 1;
-  str->buff = realloc(str->buff, str->capa);
+}
+
+/* Makes room for `amount` more chars. The capacity at least doubles,
+ * so appending one char at a time is amortized O(1). */
+static void
+string_grow(str *str, u32 amount) {
+  u32 capa = str->size + amount + 1;
+  if (capa <= str->capa) return;
+  capa = MAX(capa, str->capa * 2);
+  str->buff = memory_realloc(string_allocator(), MEMORY_TAG_STRINGS, str->buff, str->capa, capa, 1);
+  str->capa = capa;
 }
 
 void
@@ -173,10 +882,8 @@ string_copy(str *dest, str src) {
     dest->buff[0] = '\0';
     return;
   }
-  if (dest->capa < src.size) {
-    dest->capa += src.size;
-    dest->buff = realloc(dest->buff, sizeof (char) * dest->capa);
-  }
+  dest->size = 0;
+  string_grow(dest, src.size);
   memcpy(dest->buff, src.buff, sizeof (char) * src.size);
   dest->size = src.size;
   dest->buff[src.size] = '\0';
@@ -189,61 +896,348 @@ string_concat(str *dest, str src) {
     return;
   }
   if (!src.size) return;
-  if (dest->size + src.size + 1 > dest->capa) {
-    dest->capa += src.size + 1;
-    dest->buff = realloc(dest->buff, sizeof (char) * dest->capa);
-  }
+  string_grow(dest, src.size);
   memcpy(dest->buff + dest->size, src.buff, sizeof (char) * src.size);
   dest->size += src.size;
   dest->buff[dest->size] = '\0';
 }
 
-b8
-string_equal(str s1, str s2) {
-  if (s1.size != s2.size) return false;
-  for (u32 i = 0; i < s1.size; i++) {
-    if (s1.buff[i] != s2.buff[i]) return false;
+void
+string_clear(str *str) {
+  if (!str->capa) {
+    wrn("string_clear(): `str` must have been created by `string_create()`\n");
+    return;
   }
-  return true;
+  str->size = 0;
+  str->buff[0] = '\0';
 }
 
-str
-string_view(str src, u32 start, u32 end) {
-  if (start > end) {
-    wrn("string_view(): `end` must be greater or equal to `start`\n");
-    return STR_0;
+void
+string_append_char(str *dest, char c) {
+  if (!dest->capa) {
+    wrn("string_append_char(): `dest` must have been created by `string_create()`\n");
+    return;
   }
-  if (end >= src.size) {
-    wrn("string_view(): `end`(%u) is out of bounds on `src` size(%u)\n", end, src.size);
-    return STR_0;
+  string_grow(dest, 1);
+  dest->buff[dest->size++] = c;
+  dest->buff[dest->size]   = '\0';
+}
+
+/* Pairs of decimal digits, the integers are written two digits at a time. */
+static const char string_digits[] =
+  "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+  "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+  "8081828384858687888990919293949596979899";
+
+/* Writes `value` in decimal right before `end`, returns where it starts. */
+static cstr
+string_u64_digits(cstr end, u64 value) {
+  while (value >= 100) {
+    u32 pair = (value % 100) * 2;
+    value /= 100;
+    *--end = string_digits[pair + 1];
+    *--end = string_digits[pair];
   }
-  return (str) {
-    .size = end - start + 1,
-    .buff = src.buff + start,
-    .capa = 0
-  };
+  if (value >= 10) {
+    *--end = string_digits[value * 2 + 1];
+    *--end = string_digits[value * 2];
+  } else {
+    *--end = '0' + value;
+  }
+  return end;
 }
 
-str
-string_sub(str src, u32 start, u32 end) {
-  return string_create(string_view(src, start, end));
+/* Appends the chars from `start` to `end`, `dest` was already checked. */
+static void
+string_append_range(str *dest, const char *start, const char *end) {
+  u32 size = end - start;
+  string_grow(dest, size);
+  memcpy(dest->buff + dest->size, start, size);
+  dest->size += size;
+  dest->buff[dest->size] = '\0';
 }
 
 void
-string_insert(str *dest, str src, u32 index) {
+string_append_u64(str *dest, u64 value) {
   if (!dest->capa) {
-    wrn("string_insert(): `dest` must have been created by `string_create()`\n");
+    wrn("string_append_u64(): `dest` must have been created by `string_create()`\n");
     return;
   }
-  if (!src.size) return;
+  char digits[20];
+  string_append_range(dest, string_u64_digits(digits + sizeof (digits), value), digits + sizeof (digits));
+}
+
+void
+string_append_s64(str *dest, s64 value) {
+  if (!dest->capa) {
+    wrn("string_append_s64(): `dest` must have been created by `string_create()`\n");
+    return;
+  }
+  char digits[21];
+  cstr start = string_u64_digits(digits + sizeof (digits), value < 0 ? -(u64)value : (u64)value);
+  if (value < 0) *--start = '-';
+  string_append_range(dest, start, digits + sizeof (digits));
+}
+
+/* Above this the scaled value of `string_append_f64` could be off by more than the rounding. */
+#define STRING_F64_EXACT 9007199254740992.0 /* 2^53 */
+#define STRING_F64_DECIMALS 9
+
+void
+string_append_f64(str *dest, f64 value, u32 decimals) {
+  static const u32 scales[STRING_F64_DECIMALS + 1] = {
+    1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000, 1000000000
+  };
+  if (!dest->capa) {
+    wrn("string_append_f64(): `dest` must have been created by `string_create()`\n");
+    return;
+  }
+  f64 scaled = decimals <= STRING_F64_DECIMALS ? fabs(value) * scales[decimals] + 0.5 : INFINITY;
+  if (!(scaled < STRING_F64_EXACT)) { /* also catches NaN */
+    string_format(dest, STR("%.*f"), (s32)decimals, value);
+    return;
+  }
+  u64 fixed = (u64)scaled;
+  char digits[1 + 20 + 1 + STRING_F64_DECIMALS];
+  cstr start = digits + sizeof (digits);
+  if (decimals) {
+    u64 fraction = fixed % scales[decimals];
+    for (u32 i = 0; i < decimals; i++) {
+      *--start = '0' + fraction % 10;
+      fraction /= 10;
+    }
+    *--start = '.';
+  }
+  start = string_u64_digits(start, fixed / scales[decimals]);
+  if (value < 0) *--start = '-';
+  string_append_range(dest, start, digits + sizeof (digits));
+}
+
+void
+string_vformat(str *dest, str fmt, va_list args) {
+  if (!dest->capa) {
+    wrn("string_format(): `dest` must have been created by `string_create()`\n");
+    return;
+  }
+  va_list args_copy;
+  va_copy(args_copy, args);
+  s32 size = vsnprintf(dest->buff + dest->size, dest->capa - dest->size, fmt.buff, args_copy);
+  va_end(args_copy);
+  if (size < 0) {
+    wrn("string_format(): invalid format '%.*s'\n", fmt.size, fmt.buff);
+    dest->buff[dest->size] = '\0';
+    return;
+  }
+  if ((u32)size >= dest->capa - dest->size) {
+    string_grow(dest, size);
+    vsnprintf(dest->buff + dest->size, size + 1, fmt.buff, args);
+  }
+  dest->size += size;
+}
+
+void
+string_format(str *dest, str fmt, ...) {
+  va_list args;
+  va_start(args, fmt);
+  string_vformat(dest, fmt, args);
+  va_end(args);
+}
+
+str
+string_vformat_arena(arena *arena, str fmt, va_list args) {
+  /* formats right at the end of the arena first, most strings fit there */
+  arena_block *block = arena->block;
+  cstr chars = (cstr)ARENA_BLOCK_DATA(block) + block->used;
+  va_list args_copy;
+  va_copy(args_copy, args);
+  s32 size = vsnprintf(chars, block->capa - block->used, fmt.buff, args_copy);
+  va_end(args_copy);
+  if (size < 0) {
+    wrn("string_format_arena(): invalid format '%.*s'\n", fmt.size, fmt.buff);
+    return STR_0;
+  }
+  if ((u64)size < block->capa - block->used) {
+    /* aligned to 1 the allocation starts right where it was formatted */
+    return (str) { size, 0, arena_alloc(arena, size + 1, 1) };
+  }
+  chars = arena_alloc(arena, size + 1, 1);
+  vsnprintf(chars, size + 1, fmt.buff, args);
+  return (str) { size, 0, chars };
+}
+
+str
+string_format_arena(arena *arena, str fmt, ...) {
+  va_list args;
+  va_start(args, fmt);
+  str result = string_vformat_arena(arena, fmt, args);
+  va_end(args);
+  return result;
+}
+
+str
+frame_format(str fmt, ...) {
+  va_list args;
+  va_start(args, fmt);
+  str result = string_vformat_arena(frame_arena_get(), fmt, args);
+  va_end(args);
+  return result;
+}
+
+/* The search kernels scan `STRING_VEC` bytes at a time and finish with a
+ * scalar tail. Each match helper returns a bitmask with the bit `i` set
+ * when the byte `i` of the vector matches. */
+#if defined(__AVX2__)
+#define STRING_VEC 32
+typedef __m256i string_vec;
+
+static inline string_vec
+string_vec_load(const char *p) {
+  return _mm256_loadu_si256((const __m256i *)p);
+}
+
+static inline string_vec
+string_vec_set(char c) {
+  return _mm256_set1_epi8(c);
+}
+
+static inline u32
+string_vec_match(string_vec a, string_vec b) {
+  return (u32)_mm256_movemask_epi8(_mm256_cmpeq_epi8(a, b));
+}
+
+/* adds one to the byte counters of `counts` where `a` and `b` match */
+static inline string_vec
+string_vec_count(string_vec counts, string_vec a, string_vec b) {
+  return _mm256_sub_epi8(counts, _mm256_cmpeq_epi8(a, b));
+}
+
+/* returns the high bit of every byte, set on the ones that aren't ASCII */
+static inline u32
+string_vec_non_ascii(string_vec v) {
+  return (u32)_mm256_movemask_epi8(v);
+}
+
+static inline u32
+string_vec_sum(string_vec counts) {
+  __m256i sums = _mm256_sad_epu8(counts, _mm256_setzero_si256());
+  __m128i sum  = _mm_add_epi64(_mm256_castsi256_si128(sums), _mm256_extracti128_si256(sums, 1));
+  return (u32)_mm_cvtsi128_si32(sum) + (u32)_mm_extract_epi16(sum, 4);
+}
+#elif defined(__SSE2__)
+#define STRING_VEC 16
+typedef __m128i string_vec;
+
+static inline string_vec
+string_vec_load(const char *p) {
+  return _mm_loadu_si128((const __m128i *)p);
+}
+
+static inline string_vec
+string_vec_set(char c) {
+  return _mm_set1_epi8(c);
+}
+
+static inline u32
+string_vec_match(string_vec a, string_vec b) {
+  return (u32)_mm_movemask_epi8(_mm_cmpeq_epi8(a, b));
+}
+
+/* adds one to the byte counters of `counts` where `a` and `b` match */
+static inline string_vec
+string_vec_count(string_vec counts, string_vec a, string_vec b) {
+  return _mm_sub_epi8(counts, _mm_cmpeq_epi8(a, b));
+}
+
+/* returns the high bit of every byte, set on the ones that aren't ASCII */
+static inline u32
+string_vec_non_ascii(string_vec v) {
+  return (u32)_mm_movemask_epi8(v);
+}
+
+static inline u32
+string_vec_sum(string_vec counts) {
+  __m128i sum = _mm_sad_epu8(counts, _mm_setzero_si128());
+  return (u32)_mm_cvtsi128_si32(sum) + (u32)_mm_extract_epi16(sum, 4);
+}
+#endif
+
+#ifdef STRING_VEC
+#define STRING_VEC_ALL ((u32)(((u64)1 << STRING_VEC) - 1))
+
+#ifdef __GNUC__
+#define STRING_CLZ32(X) ((u32)__builtin_clz(X))
+#else
+static inline u32
+STRING_CLZ32(u32 x) {
+  u32 n = 0;
+  while (!(x & 0x80000000u)) { x <<= 1; n++; }
+  return n;
+}
+#endif
+#endif
+
+b8
+string_equal(str s1, str s2) {
+  if (s1.size != s2.size) return false;
+  if (s1.buff == s2.buff) return true;
+  u32 i = 0;
+#ifdef STRING_VEC
+  if (s1.size >= STRING_VEC) {
+    for (; i + STRING_VEC <= s1.size; i += STRING_VEC) {
+      if (string_vec_match(string_vec_load(s1.buff + i), string_vec_load(s2.buff + i)) != STRING_VEC_ALL) return false;
+    }
+    /* the tail is one more vector overlapping the end */
+    if (i == s1.size) return true;
+    i = s1.size - STRING_VEC;
+    return string_vec_match(string_vec_load(s1.buff + i), string_vec_load(s2.buff + i)) == STRING_VEC_ALL;
+  }
+#endif
+  for (; i + sizeof (u64) <= s1.size; i += sizeof (u64)) {
+    u64 w1, w2;
+    memcpy(&w1, s1.buff + i, sizeof (u64));
+    memcpy(&w2, s2.buff + i, sizeof (u64));
+    if (w1 != w2) return false;
+  }
+  for (; i < s1.size; i++) {
+    if (s1.buff[i] != s2.buff[i]) return false;
+  }
+  return true;
+}
+
+str
+string_view(str src, u32 start, u32 end) {
+  if (start > end) {
+    wrn("string_view(): `end` must be greater or equal to `start`\n");
+    return STR_0;
+  }
+  if (end >= src.size) {
+    wrn("string_view(): `end`(%u) is out of bounds on `src` size(%u)\n", end, src.size);
+    return STR_0;
+  }
+  return (str) {
+    .size = end - start + 1,
+    .buff = src.buff + start,
+    .capa = 0
+  };
+}
+
+str
+string_sub(str src, u32 start, u32 end) {
+  return string_create(string_view(src, start, end));
+}
+
+void
+string_insert(str *dest, str src, u32 index) {
+  if (!dest->capa) {
+    wrn("string_insert(): `dest` must have been created by `string_create()`\n");
+    return;
+  }
+  if (!src.size) return;
   if (index >= dest->size) {
     wrn("string_insert(): `index`(%u) is out of bounds on `dest` size(%u)\n", index, dest->size);
     return;
   }
-  if (dest->size + src.size + 1 > dest->capa) {
-    dest->capa += src.size + 1;
-    dest->buff = realloc(dest->buff, sizeof (char) * dest->capa);
-  }
+  string_grow(dest, src.size);
   memmove(dest->buff + index + src.size, dest->buff + index, dest->size - index);
   memcpy(dest->buff + index, src.buff, src.size);
   dest->size += src.size;
@@ -252,7 +1246,15 @@ string_insert(str *dest, str src, u32 index) {
 
 s8 *
 string_find_first(str str, s8 c) {
-  for (u32 i = 0; i < str.size; i++) {
+  u32 i = 0;
+#ifdef STRING_VEC
+  string_vec needle = string_vec_set(c);
+  for (; i + STRING_VEC <= str.size; i += STRING_VEC) {
+    u32 mask = string_vec_match(string_vec_load(str.buff + i), needle);
+    if (mask) return (s8 *)(str.buff + i + CTZ32(mask));
+  }
+#endif
+  for (; i < str.size; i++) {
     if (str.buff[i] == c) return (s8 *)(str.buff + i);
   }
   return 0;
@@ -260,12 +1262,204 @@ string_find_first(str str, s8 c) {
 
 s8 *
 string_find_last(str str, s8 c) {
-  for (u32 i = str.size - 1; i != (u32)-1; i--) {
+  u32 i = str.size;
+#ifdef STRING_VEC
+  string_vec needle = string_vec_set(c);
+  for (; i >= STRING_VEC; i -= STRING_VEC) {
+    u32 mask = string_vec_match(string_vec_load(str.buff + i - STRING_VEC), needle);
+    if (mask) return (s8 *)(str.buff + i - 1 - STRING_CLZ32(mask) + (32 - STRING_VEC));
+  }
+#endif
+  for (i--; i != (u32)-1; i--) {
     if (str.buff[i] == c) return (s8 *)(str.buff + i);
   }
   return 0;
 }
 
+s8 *
+string_find(str haystack, str needle) {
+  if (!needle.size) return (s8 *)haystack.buff;
+  if (needle.size > haystack.size) return 0;
+  if (needle.size == 1) return string_find_first(haystack, needle.buff[0]);
+  u32 last = haystack.size - needle.size; /* the last position where `needle` fits */
+  u32 i = 0;
+#ifdef STRING_VEC
+  /* candidates match both the first and the last byte of `needle`,
+   * only those get compared in full */
+  string_vec first_byte = string_vec_set(needle.buff[0]);
+  string_vec last_byte  = string_vec_set(needle.buff[needle.size - 1]);
+  for (; i + STRING_VEC <= last + 1; i += STRING_VEC) {
+    u32 mask = string_vec_match(string_vec_load(haystack.buff + i), first_byte) &
+               string_vec_match(string_vec_load(haystack.buff + i + needle.size - 1), last_byte);
+    for (; mask; mask &= mask - 1) {
+      u32 j = i + CTZ32(mask);
+      if (!memcmp(haystack.buff + j + 1, needle.buff + 1, needle.size - 2)) return (s8 *)(haystack.buff + j);
+    }
+  }
+#endif
+  for (; i <= last; i++) {
+    if (haystack.buff[i] == needle.buff[0] && !memcmp(haystack.buff + i + 1, needle.buff + 1, needle.size - 1)) {
+      return (s8 *)(haystack.buff + i);
+    }
+  }
+  return 0;
+}
+
+u32
+string_count(str str, s8 c) {
+  u32 count = 0;
+  u32 i = 0;
+#ifdef STRING_VEC
+  /* every byte lane counts its matches, they are summed before any can overflow */
+  string_vec needle = string_vec_set(c);
+  while (i + STRING_VEC <= str.size) {
+    string_vec counts = string_vec_set(0);
+    for (u32 n = 0; n < 255 && i + STRING_VEC <= str.size; n++, i += STRING_VEC) {
+      counts = string_vec_count(counts, string_vec_load(str.buff + i), needle);
+    }
+    count += string_vec_sum(counts);
+  }
+#endif
+  for (; i < str.size; i++) count += str.buff[i] == c;
+  return count;
+}
+
+b8
+string_split(str *src, s8 separator, str *part) {
+  if (!src->buff) return false;
+  s8 *found = string_find_first(*src, separator);
+  if (!found) {
+    *part = *src;
+    *src  = STR_0;
+    return true;
+  }
+  u32 size = (cstr)found - src->buff;
+  *part = (str) { .size = size, .capa = 0, .buff = src->buff };
+  *src  = (str) { .size = src->size - size - 1, .capa = 0, .buff = (cstr)found + 1 };
+  return true;
+}
+
+/* Decodes the UTF-8 sequence at the start of the `size` bytes of `s`. Returns
+ * its length or 0 when it's malformed, overlong, a surrogate or past U+10FFFF. */
+static inline u32
+string_utf8_decode(const u8 *s, u32 size, u32 *codepoint) {
+  u32 length, min;
+  if (s[0] < 0x80) {
+    *codepoint = s[0];
+    return 1;
+  } else if ((s[0] & 0xe0) == 0xc0) {
+    length = 2; min = 0x80;    *codepoint = s[0] & 0x1f;
+  } else if ((s[0] & 0xf0) == 0xe0) {
+    length = 3; min = 0x800;   *codepoint = s[0] & 0x0f;
+  } else if ((s[0] & 0xf8) == 0xf0) {
+    length = 4; min = 0x10000; *codepoint = s[0] & 0x07;
+  } else {
+    return 0;
+  }
+  if (length > size) return 0;
+  for (u32 i = 1; i < length; i++) {
+    if ((s[i] & 0xc0) != 0x80) return 0;
+    *codepoint = (*codepoint << 6) | (s[i] & 0x3f);
+  }
+  if (*codepoint < min || *codepoint > 0x10ffff || (*codepoint >= 0xd800 && *codepoint <= 0xdfff)) return 0;
+  return length;
+}
+
+/* Returns how many bytes from `i` on are ASCII, counted a vector at a time. */
+static inline u32
+string_ascii_run(str str, u32 i) {
+  u32 start = i;
+#ifdef STRING_VEC
+  for (; i + STRING_VEC <= str.size; i += STRING_VEC) {
+    u32 mask = string_vec_non_ascii(string_vec_load(str.buff + i));
+    if (mask) return i + CTZ32(mask) - start;
+  }
+#endif
+  while (i < str.size && !(str.buff[i] & 0x80)) i++;
+  return i - start;
+}
+
+b8
+string_utf8_valid(str str) {
+  u32 codepoint;
+  for (u32 i = 0; i < str.size;) {
+    if (!(str.buff[i] & 0x80)) {
+      i += string_ascii_run(str, i);
+      continue;
+    }
+    u32 length = string_utf8_decode((const u8 *)str.buff + i, str.size - i, &codepoint);
+    if (!length) return false;
+    i += length;
+  }
+  return true;
+}
+
+u32
+string_utf8_length(str str) {
+  u32 length = 0;
+  for (u32 i = 0; i < str.size;) {
+    if (!(str.buff[i] & 0x80)) {
+      u32 ascii = string_ascii_run(str, i);
+      length += ascii;
+      i      += ascii;
+      continue;
+    }
+    string_utf8_next(str, &i);
+    length++;
+  }
+  return length;
+}
+
+u32
+string_utf8_next(str str, u32 *index) {
+  u32 codepoint;
+  u32 length = string_utf8_decode((const u8 *)str.buff + *index, str.size - *index, &codepoint);
+  if (!length) {
+    (*index)++;
+    return UTF8_INVALID;
+  }
+  *index += length;
+  return codepoint;
+}
+
+/* Writes the UTF-8 encoding of `codepoint` (UTF8_INVALID when it isn't one)
+ * on `out`, which has room for 4 bytes. Returns how many it took. */
+static u32
+string_utf8_encode(u32 codepoint, u8 *out) {
+  if (codepoint > 0x10ffff || (codepoint >= 0xd800 && codepoint <= 0xdfff)) codepoint = UTF8_INVALID;
+  if (codepoint < 0x80) {
+    out[0] = codepoint;
+    return 1;
+  }
+  if (codepoint < 0x800) {
+    out[0] = 0xc0 | (codepoint >> 6);
+    out[1] = 0x80 | (codepoint & 0x3f);
+    return 2;
+  }
+  if (codepoint < 0x10000) {
+    out[0] = 0xe0 | (codepoint >> 12);
+    out[1] = 0x80 | ((codepoint >> 6) & 0x3f);
+    out[2] = 0x80 | (codepoint & 0x3f);
+    return 3;
+  }
+  out[0] = 0xf0 | (codepoint >> 18);
+  out[1] = 0x80 | ((codepoint >> 12) & 0x3f);
+  out[2] = 0x80 | ((codepoint >> 6) & 0x3f);
+  out[3] = 0x80 | (codepoint & 0x3f);
+  return 4;
+}
+
+void
+string_append_utf8(str *dest, u32 codepoint) {
+  if (!dest->capa) {
+    wrn("string_append_utf8(): `dest` must have been created by `string_create()`\n");
+    return;
+  }
+  string_grow(dest, 4);
+  dest->size += string_utf8_encode(codepoint, (u8 *)dest->buff + dest->size);
+  dest->buff[dest->size] = '\0';
+}
+
 void
 string_reverse(str str) {
   if (!str.capa) {
@@ -289,184 +1483,1047 @@ string_destroy(str str) {
     wrn("string_destroy(): `str` must have been created by `string_create()`\n");
     return;
   }
-  free(str.buff);
+  memory_free(string_allocator(), MEMORY_TAG_STRINGS, str.buff, str.capa);
 }
 
 /*
- * 
- * *** Array List ***
+ *
+ * *** Text Buffer ***
  *
  * */
 
-typedef struct {
-  u32 size;
-  u32 capa;
-  u32 type;
-} array_list_header;
-#define ARRAY_LIST_HEADER(ARR) (((array_list_header *)ARR) - 1)
+/* A new text buffer starts with room for this many bytes and line breaks. */
+#define TEXT_BUFFER_MIN_CAPA   64
+#define TEXT_BUFFER_MIN_BREAKS 16
 
-void *
-array_list_create(u32 type_size) {
-  array_list_header *header = malloc(sizeof (array_list_header) + type_size);
-  header->type = type_size;
-  header->size = 0;
-  header->capa = 1;
-  return header + 1;
+/*
+ * The text is `buff[0, gap_start)` followed by `buff[gap_end, capa)`. The line
+ * breaks are split at the gap too: the ones before it are kept on the front of
+ * `breaks` as their position, the ones after it on the back as their distance
+ * to the end of the text. Editing at the gap leaves both halves untouched,
+ * moving the gap carries the breaks it crosses to the other half.
+ */
+struct text_buffer {
+  const blib_allocator *allocator;
+  char *buff;
+  u32  *breaks;
+  u32   capa;
+  u32   gap_start;
+  u32   gap_end;
+  u32   cursor;
+  u32   breaks_capa;
+  u32   breaks_before;
+  u32   breaks_after;
+};
+
+#define TEXT_BUFFER_GAP(T)  ((T)->gap_end - (T)->gap_start)
+#define TEXT_BUFFER_SIZE(T) ((T)->capa - TEXT_BUFFER_GAP(T))
+
+/* Returns the position of the line break `index`. */
+static inline u32
+text_buffer_break(text_buffer *text, u32 index) {
+  if (index < text->breaks_before) return text->breaks[index];
+  index += text->breaks_capa - text->breaks_after - text->breaks_before;
+  return TEXT_BUFFER_SIZE(text) - text->breaks[index];
+}
+
+/* Moves the gap to the position `index`. */
+static void
+text_buffer_move_gap(text_buffer *text, u32 index) {
+  u32 size = TEXT_BUFFER_SIZE(text);
+  if (index < text->gap_start) {
+    u32 amount = text->gap_start - index;
+    memmove(text->buff + text->gap_end - amount, text->buff + index, amount);
+    text->gap_start -= amount;
+    text->gap_end   -= amount;
+    while (text->breaks_before && text->breaks[text->breaks_before - 1] >= index) {
+      u32 position = text->breaks[--text->breaks_before];
+      text->breaks[text->breaks_capa - ++text->breaks_after] = size - position;
+    }
+  } else if (index > text->gap_start) {
+    u32 amount = index - text->gap_start;
+    memmove(text->buff + text->gap_start, text->buff + text->gap_end, amount);
+    text->gap_start += amount;
+    text->gap_end   += amount;
+    while (text->breaks_after && size - text->breaks[text->breaks_capa - text->breaks_after] < index) {
+      u32 position = size - text->breaks[text->breaks_capa - text->breaks_after--];
+      text->breaks[text->breaks_before++] = position;
+    }
+  }
+}
+
+/* Makes room for `amount` more bytes on the gap. The capacity at least doubles,
+ * so typing one char at a time is amortized O(1). */
+static void
+text_buffer_grow(text_buffer *text, u32 amount) {
+  if (TEXT_BUFFER_GAP(text) >= amount) return;
+  u32 capa  = MAX(TEXT_BUFFER_SIZE(text) + amount, text->capa * 2);
+  u32 after = text->capa - text->gap_end;
+  text->buff = memory_realloc(text->allocator, MEMORY_TAG_STRINGS, text->buff, text->capa, capa, 1);
+  memmove(text->buff + capa - after, text->buff + text->gap_end, after);
+  text->gap_end = capa - after;
+  text->capa    = capa;
+}
+
+/* Makes room for `amount` more line breaks, the same way. */
+static void
+text_buffer_grow_breaks(text_buffer *text, u32 amount) {
+  if (text->breaks_capa - text->breaks_before - text->breaks_after >= amount) return;
+  u32 capa = MAX(text->breaks_before + text->breaks_after + amount, text->breaks_capa * 2);
+  text->breaks = memory_realloc(text->allocator, MEMORY_TAG_STRINGS, text->breaks,
+      sizeof (u32) * text->breaks_capa, sizeof (u32) * capa, sizeof (u32));
+  memmove(text->breaks + capa - text->breaks_after, text->breaks + text->breaks_capa - text->breaks_after,
+      sizeof (u32) * text->breaks_after);
+  text->breaks_capa = capa;
+}
+
+/* Returns a view of the text from `start` to `end`, the gap must not be between them. */
+static str
+text_buffer_view(text_buffer *text, u32 start, u32 end) {
+  cstr buff = text->buff + start + (start >= text->gap_start && start != end ? TEXT_BUFFER_GAP(text) : 0);
+  return (str) { end - start, 0, buff };
+}
+
+text_buffer *
+text_buffer_create(str src) {
+  const blib_allocator *allocator = blib_get_allocator();
+  text_buffer *text = memory_alloc(allocator, MEMORY_TAG_STRINGS, sizeof (text_buffer), BLIB_ALIGN);
+  text->allocator     = allocator;
+  text->capa          = MAX(src.size, TEXT_BUFFER_MIN_CAPA);
+  text->buff          = memory_alloc(allocator, MEMORY_TAG_STRINGS, text->capa, 1);
+  text->breaks_capa   = TEXT_BUFFER_MIN_BREAKS;
+  text->breaks        = memory_alloc(allocator, MEMORY_TAG_STRINGS, sizeof (u32) * text->breaks_capa, sizeof (u32));
+  text->gap_start     = 0;
+  text->gap_end       = text->capa;
+  text->cursor        = 0;
+  text->breaks_before = 0;
+  text->breaks_after  = 0;
+  text_buffer_insert(text, src);
+  return text;
 }
 
 u32
-array_list_capacity(void *arr) {
-  return ARRAY_LIST_HEADER(arr)->capa;
+text_buffer_size(text_buffer *text) {
+  return TEXT_BUFFER_SIZE(text);
+}
+
+u32
+text_buffer_cursor(text_buffer *text) {
+  return text->cursor;
+}
+
+void
+text_buffer_seek(text_buffer *text, u32 index) {
+  text->cursor = MIN(index, TEXT_BUFFER_SIZE(text));
+}
+
+void
+text_buffer_insert(text_buffer *text, str src) {
+  if (!src.size) return;
+  text_buffer_move_gap(text, text->cursor);
+  text_buffer_grow(text, src.size);
+  memcpy(text->buff + text->gap_start, src.buff, src.size);
+  u32 breaks = string_count(src, '\n');
+  if (breaks) {
+    text_buffer_grow_breaks(text, breaks);
+    str rest = src;
+    for (s8 *found; (found = string_find_first(rest, '\n'));) {
+      u32 offset = (cstr)found - src.buff;
+      text->breaks[text->breaks_before++] = text->gap_start + offset;
+      rest.buff = (cstr)found + 1;
+      rest.size = src.size - offset - 1;
+    }
+  }
+  text->gap_start += src.size;
+  text->cursor    += src.size;
+}
+
+void
+text_buffer_insert_utf8(text_buffer *text, u32 codepoint) {
+  char bytes[4];
+  u32 size = string_utf8_encode(codepoint, (u8 *)bytes);
+  text_buffer_insert(text, (str) { size, 0, bytes });
+}
+
+void
+text_buffer_delete(text_buffer *text, u32 amount) {
+  u32 size = TEXT_BUFFER_SIZE(text);
+  amount = MIN(amount, size - text->cursor);
+  if (!amount) return;
+  text_buffer_move_gap(text, text->cursor);
+  while (text->breaks_after && size - text->breaks[text->breaks_capa - text->breaks_after] < text->gap_start + amount) {
+    text->breaks_after--;
+  }
+  text->gap_end += amount;
+}
+
+void
+text_buffer_backspace(text_buffer *text, u32 amount) {
+  amount = MIN(amount, text->cursor);
+  if (!amount) return;
+  text_buffer_move_gap(text, text->cursor);
+  while (text->breaks_before && text->breaks[text->breaks_before - 1] >= text->gap_start - amount) {
+    text->breaks_before--;
+  }
+  text->gap_start -= amount;
+  text->cursor    -= amount;
+}
+
+void
+text_buffer_clear(text_buffer *text) {
+  text->gap_start     = 0;
+  text->gap_end       = text->capa;
+  text->cursor        = 0;
+  text->breaks_before = 0;
+  text->breaks_after  = 0;
+}
+
+void
+text_buffer_parts(text_buffer *text, str *before, str *after) {
+  *before = (str) { text->gap_start, 0, text->buff };
+  *after  = (str) { text->capa - text->gap_end, 0, text->buff + text->gap_end };
+}
+
+str
+text_buffer_str(text_buffer *text) {
+  text_buffer_move_gap(text, TEXT_BUFFER_SIZE(text));
+  return (str) { text->gap_start, 0, text->buff };
+}
+
+u32
+text_buffer_lines(text_buffer *text) {
+  return text->breaks_before + text->breaks_after + 1;
+}
+
+u32
+text_buffer_line_start(text_buffer *text, u32 line) {
+  if (line >= text_buffer_lines(text)) {
+    wrn("text_buffer_line_start(): line '%u' is out of bounds\n", line);
+    return TEXT_BUFFER_SIZE(text);
+  }
+  return line ? text_buffer_break(text, line - 1) + 1 : 0;
+}
+
+u32
+text_buffer_line_at(text_buffer *text, u32 index) {
+  /* the line of `index` is the amount of breaks before it */
+  u32 low  = 0;
+  u32 high = text->breaks_before + text->breaks_after;
+  while (low < high) {
+    u32 middle = low + (high - low) / 2;
+    if (text_buffer_break(text, middle) < index) low = middle + 1;
+    else                                         high = middle;
+  }
+  return low;
+}
+
+str
+text_buffer_line(text_buffer *text, u32 line) {
+  if (line >= text_buffer_lines(text)) {
+    wrn("text_buffer_line(): line '%u' is out of bounds\n", line);
+    return STR_0;
+  }
+  u32 start = line ? text_buffer_break(text, line - 1) + 1 : 0;
+  u32 end   = line < text_buffer_lines(text) - 1 ? text_buffer_break(text, line) : TEXT_BUFFER_SIZE(text);
+  if (text->gap_start > start && text->gap_start < end) text_buffer_move_gap(text, end);
+  return text_buffer_view(text, start, end);
+}
+
+void
+text_buffer_destroy(text_buffer *text) {
+  memory_free(text->allocator, MEMORY_TAG_STRINGS, text->breaks, sizeof (u32) * text->breaks_capa);
+  memory_free(text->allocator, MEMORY_TAG_STRINGS, text->buff, text->capa);
+  memory_free(text->allocator, MEMORY_TAG_STRINGS, text, sizeof (text_buffer));
+}
+
+/*
+ * 
+ * *** Array List ***
+ *
+ * */
+
+/* The private part of an array list allocation. It starts the allocation and the
+ * header (declared on blib.h since the typed array lists use it) ends it right
+ * before the items, which start ARRAY_LIST_PREFIX bytes in so they stay aligned. */
+typedef struct {
+  const blib_allocator *allocator;
+  memory_tag            tag;
+#ifdef BLIB_CONTAINER_STATS
+  array_list_stats      stats;
+#endif
+} array_list_block;
+#define ARRAY_LIST_PREFIX        ALIGN_UP(sizeof (array_list_block) + sizeof (array_list_header), BLIB_ALIGN)
+#define ARRAY_LIST_BLOCK(HEADER) ((array_list_block *)((u8 *)((HEADER) + 1) - ARRAY_LIST_PREFIX))
+#define ARRAY_LIST_BYTES(CAPA, TYPE) (ARRAY_LIST_PREFIX + (u64)(CAPA) * (TYPE))
+
+/* Creates an array list whose memory is counted as `tag`'s. */
+static void *
+array_list_create_tagged(u32 type_size, const blib_allocator *allocator, memory_tag tag) {
+  array_list_block *block = memory_alloc(allocator, tag, ARRAY_LIST_BYTES(1, type_size), BLIB_ALIGN);
+  array_list_header *header = (array_list_header *)((u8 *)block + ARRAY_LIST_PREFIX) - 1;
+  block->allocator = allocator;
+  block->tag       = tag;
+  header->type = type_size;
+  header->size = 0;
+  header->capa = 1;
+#ifdef BLIB_CONTAINER_STATS
+  memset(&block->stats, 0, sizeof (array_list_stats));
+  block->stats.peak_capacity = 1;
+#endif
+  return header + 1;
+}
+
+void *
+array_list_create_with(u32 type_size, const blib_allocator *allocator) {
+  return array_list_create_tagged(type_size, allocator, MEMORY_TAG_ARRAY_LISTS);
+}
+
+void *
+array_list_create(u32 type_size) {
+  return array_list_create_with(type_size, blib_get_allocator());
+}
+
+/* Reallocates the list to `capa` items, `used` items are kept. */
+static array_list_header *
+array_list_realloc(array_list_header *header, u32 used, u32 capa) {
+  u32 type = header->type;
+  u64 old_size = ARRAY_LIST_BYTES(header->capa, type);
+  array_list_block *block = ARRAY_LIST_BLOCK(header);
+#ifdef BLIB_CONTAINER_STATS
+  uintptr_t old = (uintptr_t)block;
+  block = memory_realloc(block->allocator, block->tag, block, old_size, ARRAY_LIST_BYTES(capa, type), BLIB_ALIGN);
+  block->stats.reallocs++;
+  if ((uintptr_t)block != old) block->stats.bytes_copied += (u64)used * type;
+  block->stats.peak_capacity = MAX(block->stats.peak_capacity, capa);
+#else
+  block = memory_realloc(block->allocator, block->tag, block, old_size, ARRAY_LIST_BYTES(capa, type), BLIB_ALIGN);
+  (void)used;
+#endif
+  header = (array_list_header *)((u8 *)block + ARRAY_LIST_PREFIX) - 1;
+  header->capa = capa;
+  return header;
+}
+
+u32
+array_list_capacity(void *arr) {
+  return ARRAY_LIST_HEADER(arr)->capa;
+}
+
+u32
+array_list_size(void *arr) {
+  return ARRAY_LIST_HEADER(arr)->size;
+}
+
+void *
+array_list_reserve(void *arr, u32 amount) {
+  array_list_header *header = ARRAY_LIST_HEADER(arr);
+  header = array_list_realloc(header, header->size, header->capa + amount);
+  return header + 1;
+}
+
+void *
+array_list_grow(void *arr, u32 amount) {
+  array_list_header *header = ARRAY_LIST_HEADER(arr);
+  header->size += amount;
+  if (header->size >= header->capa) {
+    u32 capa = header->capa;
+    while (header->size >= capa) capa *= 2;
+    header = array_list_realloc(header, header->size - amount, capa);
+  }
+  return header + 1;
+}
+
+void
+array_list_shift_left(void *arr, u32 index, u32 amount) {
+  if (amount == 0) return;
+  array_list_header *header = ARRAY_LIST_HEADER(arr);
+  if (amount > index) {
+    index = amount;
+  }
+  if (index >= header->size) return;
+  memmove(
+      (u8 *)arr + (index - amount) * header->type,
+      (u8 *)arr +  index           * header->type,
+      (header->size - index) * header->type);
+}
+
+void
+array_list_shift_right(void *arr, u32 index, u32 amount) {
+  if (amount == 0) return;
+  array_list_header *header = ARRAY_LIST_HEADER(arr);
+  if (index + amount >= header->size) return;
+  memmove(
+      (u8 *)arr + (index + amount) * header->type,
+      (u8 *)arr +  index           * header->type,
+      (header->size - (index + amount)) * header->type);
+}
+
+#if 0
+void *
+array_list_push(void *arr, void *item) {
+  arr = array_list_grow(arr, 1);
+  array_list_header *header = ARRAY_LIST_HEADER(arr);
+  memcpy((u8 *)arr + header->type * (header->size - 1), item, header->type);
+  return arr;
+}
+
+void *
+array_list_insert(void *arr, u32 index, void *item) {
+  array_list_header *header = ARRAY_LIST_HEADER(arr);
+  u32 max_index = header->size > 0 ? header->size - 1 : 0;
+  if (index > max_index) {
+    arr = array_list_grow(arr, index - max_index);
+    header = ARRAY_LIST_HEADER(arr);
+  } else {
+    arr = array_list_grow(arr, 1);
+    header = ARRAY_LIST_HEADER(arr);
+    memmove((u8 *)arr + header->type * (index + 1),
+            (u8 *)arr + header->type * (index),
+            (header->size - index) * header->type);
+  }
+  memcpy((u8 *)arr + header->type * index, item, header->type);
+  return arr;
+}
+#endif
+
+void
+array_list_pop(void *arr, void *out) {
+  array_list_header *header = ARRAY_LIST_HEADER(arr);
+  if (header->size == 0) return;
+  header->size--;
+  if (out)
+    memcpy(out, (u8 *)arr + header->type * header->size, header->type);
+}
+
+void
+array_list_remove(void *arr, u32 index, void *out) {
+  array_list_header *header = ARRAY_LIST_HEADER(arr);
+  if (header->size == 0 || index >= header->size) return;
+  if (out) memcpy(out, (u8 *)arr + header->type * index, header->type);
+  array_list_shift_left(arr, index + 1, 1);
+  header->size--;
+}
+
+void
+array_list_swap_remove(void *arr, u32 index, void *out) {
+  array_list_header *header = ARRAY_LIST_HEADER(arr);
+  if (header->size == 0 || index >= header->size) return;
+  if (out) memcpy(out, (u8 *)arr + header->type * index, header->type);
+  header->size--;
+  if (index != header->size) {
+    memcpy((u8 *)arr + header->type * index, (u8 *)arr + header->type * header->size, header->type);
+  }
+}
+
+void
+array_list_remove_range(void *arr, u32 index, u32 amount) {
+  array_list_header *header = ARRAY_LIST_HEADER(arr);
+  if (index >= header->size) return;
+  amount = MIN(amount, header->size - index);
+  memmove(
+      (u8 *)arr +  index           * header->type,
+      (u8 *)arr + (index + amount) * header->type,
+      (header->size - (index + amount)) * header->type);
+  header->size -= amount;
+}
+
+u32
+array_list_remove_if(void *arr, array_list_predicate remove, void *ctx) {
+  array_list_header *header = ARRAY_LIST_HEADER(arr);
+  u8 *items = arr;
+  u32 write = 0;
+  for (u32 read = 0; read < header->size; read++) {
+    if (remove(items + read * header->type, ctx)) continue;
+    if (write != read) memcpy(items + write * header->type, items + read * header->type, header->type);
+    write++;
+  }
+  u32 removed = header->size - write;
+  header->size = write;
+  return removed;
+}
+
+/* Compacts the items of [read, end) onto `write`, returns where the next one goes.
+ * For the common sizes every item is copied and `write` only advances when it's
+ * kept, so there's no branch to mispredict. */
+static u32
+array_list_compact(u8 *items, u32 type, const b8 *keep, u32 read, u32 end, u32 write) {
+#define COMPACT(T) \
+  for (; read < end; read++) { \
+    ((T *)items)[write] = ((T *)items)[read]; \
+    write += keep[read] != 0; \
+  } \
+  break
+  switch (type) {
+    case sizeof (u8):  COMPACT(u8);
+    case sizeof (u16): COMPACT(u16);
+    case sizeof (u32): COMPACT(u32);
+    case sizeof (u64): COMPACT(u64);
+    default:
+      for (; read < end; read++) {
+        if (!keep[read]) continue;
+        if (write != read) memcpy(items + write * type, items + read * type, type);
+        write++;
+      }
+  }
+#undef COMPACT
+  return write;
+}
+
+u32
+array_list_keep_mask(void *arr, const b8 *keep) {
+  array_list_header *header = ARRAY_LIST_HEADER(arr);
+  u8 *items = arr;
+  u32 read  = 0;
+  u32 write = 0;
+#ifdef __SSE2__
+  /* blocks of 16 items that are all kept or all removed are moved or skipped at once */
+  for (; read + 16 <= header->size; read += 16) {
+    __m128i mask = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(keep + read)), _mm_setzero_si128());
+    u32 removed = _mm_movemask_epi8(mask);
+    if (removed == 0xffff) continue;
+    if (removed == 0) {
+      if (write != read) memmove(items + write * header->type, items + read * header->type, 16 * header->type);
+      write += 16;
+      continue;
+    }
+    write = array_list_compact(items, header->type, keep, read, read + 16, write);
+  }
+#endif
+  write = array_list_compact(items, header->type, keep, read, header->size, write);
+  u32 removed = header->size - write;
+  header->size = write;
+  return removed;
+}
+
+void
+array_list_clear(void *arr) {
+  array_list_header *header = ARRAY_LIST_HEADER(arr);
+   header->size = 0;
+}
+
+void
+array_list_destroy(void *arr) {
+  array_list_header *header = ARRAY_LIST_HEADER(arr);
+  array_list_block  *block  = ARRAY_LIST_BLOCK(header);
+  memory_free(block->allocator, block->tag, block, ARRAY_LIST_BYTES(header->capa, header->type));
+}
+
+array_list_stats
+array_list_get_stats(void *arr) {
+#ifdef BLIB_CONTAINER_STATS
+  return ARRAY_LIST_BLOCK(ARRAY_LIST_HEADER(arr))->stats;
+#else
+  array_list_stats stats = { 0 };
+  (void)arr;
+  return stats;
+#endif
+}
+
+void
+array_list_stats_dump(void *arr, ccstr name) {
+  array_list_stats stats = array_list_get_stats(arr);
+  inf("array list '%s': size %u, capacity %u, peak capacity %u, reallocs %u, bytes copied %lu\n",
+      name, array_list_size(arr), array_list_capacity(arr), stats.peak_capacity, stats.reallocs,
+      (unsigned long)stats.bytes_copied);
+}
+
+/*
+ *
+ * *** Segment List ***
+ *
+ * */
+
+/* Segments are about this size when `segment_list_create` isn't given a capacity. */
+#define SEGMENT_LIST_DEFAULT_BYTES (16 * 1024)
+
+/*
+ * The items live in segments of `1 << shift` items that are never moved,
+ * only the array list of segment pointers grows.
+ */
+struct segment_list {
+  u8                  **segments;
+  const blib_allocator *allocator;
+  u32                   type;
+  u32                   size;
+  u32                   shift;
+};
+
+segment_list *
+segment_list_create(u32 type_size, u32 segment_capa) {
+  if (type_size == 0) {
+    wrn("segment_list_create(): the type size can't be 0\n");
+    return 0;
+  }
+  if (segment_capa >= 1u << 31) {
+    wrn("segment_list_create(): '%u' items per segment is too many\n", segment_capa);
+    return 0;
+  }
+  const blib_allocator *allocator = blib_get_allocator();
+  segment_list *list = memory_alloc(allocator, MEMORY_TAG_ARRAY_LISTS, sizeof (segment_list), BLIB_ALIGN);
+  if (segment_capa == 0) segment_capa = MAX(SEGMENT_LIST_DEFAULT_BYTES / type_size, 1);
+  list->shift = 0;
+  while ((2u << list->shift) <= segment_capa) list->shift++;
+  list->segments  = array_list_create_with(sizeof (u8 *), allocator);
+  list->allocator = allocator;
+  list->type      = type_size;
+  list->size      = 0;
+  return list;
+}
+
+u32
+segment_list_size(segment_list *list) {
+  return list->size;
+}
+
+void *
+segment_list_get(segment_list *list, u32 index) {
+  if (index >= list->size) {
+    wrn("segment_list_get(): index '%u' is out of bounds\n", index);
+    return 0;
+  }
+  u32 mask = (1u << list->shift) - 1;
+  return list->segments[index >> list->shift] + (index & mask) * list->type;
+}
+
+void *
+segment_list_push(segment_list *list, void *item) {
+  u32 mask = (1u << list->shift) - 1;
+  if ((list->size >> list->shift) == array_list_size(list->segments)) {
+    u8 *segment = memory_alloc(list->allocator, MEMORY_TAG_ARRAY_LISTS, (u64)list->type << list->shift, BLIB_ALIGN);
+    array_list_push(list->segments, segment);
+  }
+  u8 *slot = list->segments[list->size >> list->shift] + (list->size & mask) * list->type;
+  if (item) memcpy(slot, item, list->type);
+  list->size++;
+  return slot;
+}
+
+void
+segment_list_pop(segment_list *list, void *out) {
+  if (list->size == 0) return;
+  list->size--;
+  if (out) {
+    u32 mask = (1u << list->shift) - 1;
+    memcpy(out, list->segments[list->size >> list->shift] + (list->size & mask) * list->type, list->type);
+  }
+}
+
+void
+segment_list_swap_remove(segment_list *list, u32 index, void *out) {
+  if (index >= list->size) return;
+  u8 *slot = segment_list_get(list, index);
+  if (out) memcpy(out, slot, list->type);
+  list->size--;
+  if (index != list->size) {
+    u32 mask = (1u << list->shift) - 1;
+    memcpy(slot, list->segments[list->size >> list->shift] + (list->size & mask) * list->type, list->type);
+  }
+}
+
+u32
+segment_list_segments(segment_list *list) {
+  return (list->size + (1u << list->shift) - 1) >> list->shift;
+}
+
+void *
+segment_list_segment(segment_list *list, u32 segment, u32 *out_size) {
+  if (segment >= segment_list_segments(list)) {
+    *out_size = 0;
+    return 0;
+  }
+  *out_size = MIN(list->size - (segment << list->shift), 1u << list->shift);
+  return list->segments[segment];
+}
+
+void
+segment_list_clear(segment_list *list) {
+  list->size = 0;
+}
+
+void
+segment_list_destroy(segment_list *list) {
+  for (u32 i = 0; i < array_list_size(list->segments); i++) {
+    memory_free(list->allocator, MEMORY_TAG_ARRAY_LISTS, list->segments[i], (u64)list->type << list->shift);
+  }
+  array_list_destroy(list->segments);
+  memory_free(list->allocator, MEMORY_TAG_ARRAY_LISTS, list, sizeof (segment_list));
+}
+
+/*
+ *
+ * *** Sorting ***
+ *
+ * */
+
+/* The introsort finishes ranges this small with an insertion sort. */
+#define SORT_INSERTION_MAX 16
+
+/* Radix sorts go through the keys 8 bits at a time. */
+#define SORT_RADIX_BITS 8
+#define SORT_RADIX_SIZE (1 << SORT_RADIX_BITS)
+
+/* SORT_PARALLEL splits radix sorts of at least SORT_PARALLEL_MIN items across SORT_THREADS threads. */
+#define SORT_THREADS      4
+#define SORT_PARALLEL_MIN (1 << 16)
+
+#define SORT_AT(I) (base + (u64)(I) * stride)
+
+static void
+sort_swap(u8 *a, u8 *b, u32 stride) {
+  for (; stride >= sizeof (u64); stride -= sizeof (u64), a += sizeof (u64), b += sizeof (u64)) {
+    u64 tmp;
+    memcpy(&tmp, a, sizeof (u64));
+    memcpy(a, b, sizeof (u64));
+    memcpy(b, &tmp, sizeof (u64));
+  }
+  for (; stride > 0; stride--, a++, b++) {
+    u8 tmp = *a;
+    *a = *b;
+    *b = tmp;
+  }
+}
+
+static void
+sort_insertion(u8 *base, u32 amount, u32 stride, sort_compare compare) {
+  for (u32 i = 1; i < amount; i++) {
+    for (u32 j = i; j > 0 && compare(SORT_AT(j - 1), SORT_AT(j)) > 0; j--) {
+      sort_swap(SORT_AT(j - 1), SORT_AT(j), stride);
+    }
+  }
+}
+
+static void
+sort_heap_down(u8 *base, u32 root, u32 amount, u32 stride, sort_compare compare) {
+  for (;;) {
+    u32 child = root * 2 + 1;
+    if (child >= amount) return;
+    if (child + 1 < amount && compare(SORT_AT(child), SORT_AT(child + 1)) < 0) child++;
+    if (compare(SORT_AT(root), SORT_AT(child)) >= 0) return;
+    sort_swap(SORT_AT(root), SORT_AT(child), stride);
+    root = child;
+  }
+}
+
+static void
+sort_heap(u8 *base, u32 amount, u32 stride, sort_compare compare) {
+  for (u32 i = amount / 2; i-- > 0;) sort_heap_down(base, i, amount, stride, compare);
+  for (u32 i = amount - 1; i > 0; i--) {
+    sort_swap(base, SORT_AT(i), stride);
+    sort_heap_down(base, 0, i, stride, compare);
+  }
+}
+
+/* Quicksort with a median of three pivot, falls back to heapsort once
+ * `depth` runs out so bad pivots can't make it quadratic. */
+static void
+sort_intro_range(u8 *base, u32 amount, u32 stride, sort_compare compare, u32 depth) {
+  while (amount > SORT_INSERTION_MAX) {
+    if (depth-- == 0) {
+      sort_heap(base, amount, stride, compare);
+      return;
+    }
+    u32 mid  = amount / 2;
+    u32 last = amount - 1;
+    if (compare(SORT_AT(mid),  SORT_AT(0))   < 0) sort_swap(SORT_AT(mid),  SORT_AT(0),   stride);
+    if (compare(SORT_AT(last), SORT_AT(0))   < 0) sort_swap(SORT_AT(last), SORT_AT(0),   stride);
+    if (compare(SORT_AT(last), SORT_AT(mid)) < 0) sort_swap(SORT_AT(last), SORT_AT(mid), stride);
+    /* the pivot waits at the front while partitioning, `last` stops the forward scan */
+    sort_swap(base, SORT_AT(mid), stride);
+    u32 i = 0;
+    u32 j = amount;
+    for (;;) {
+      do i++; while (compare(SORT_AT(i), base) < 0);
+      do j--; while (compare(SORT_AT(j), base) > 0);
+      if (i >= j) break;
+      sort_swap(SORT_AT(i), SORT_AT(j), stride);
+    }
+    sort_swap(base, SORT_AT(j), stride);
+    /* recurses on the smaller side so the stack stays logarithmic */
+    if (j < amount - j - 1) {
+      sort_intro_range(base, j, stride, compare, depth);
+      base   = SORT_AT(j + 1);
+      amount = amount - j - 1;
+    } else {
+      sort_intro_range(SORT_AT(j + 1), amount - j - 1, stride, compare, depth);
+      amount = j;
+    }
+  }
+  sort_insertion(base, amount, stride, compare);
+}
+
+void
+sort_intro(void *items, u32 amount, u32 stride, sort_compare compare) {
+  u32 depth = 0;
+  for (u32 n = amount; n > 1; n >>= 1) depth += 2;
+  sort_intro_range(items, amount, stride, compare, depth);
 }
 
-u32
-array_list_size(void *arr) {
-  return ARRAY_LIST_HEADER(arr)->size;
-}
+#undef SORT_AT
 
-void *
-array_list_reserve(void *arr, u32 amount) {
-  array_list_header *header = ARRAY_LIST_HEADER(arr);
-  header->capa += amount;
-  header = realloc(header, sizeof (array_list_header) + header->type * header->capa);
-  return header + 1;
+/* Maps a f32 to a u32 with the same order, negatives included. */
+static inline u32
+sort_f32_key(f32 value) {
+  u32 bits;
+  memcpy(&bits, &value, sizeof (u32));
+  return bits & 0x80000000u ? ~bits : bits | 0x80000000u;
 }
 
-void *
-array_list_grow(void *arr, u32 amount) {
-  array_list_header *header = ARRAY_LIST_HEADER(arr);
-  header->size += amount;
-  if (header->size >= header->capa) {
-    header->capa *= 2;
-    header = realloc(header, sizeof (array_list_header) + header->type * header->capa);
+/* One thread's share of a radix pass over the items [from, to). */
+typedef struct {
+  u64 *keys;
+  u64 *keys_out;
+  u32 *indexes;
+  u32 *indexes_out;
+  u32  from;
+  u32  to;
+  u32  shift;
+  u32  counts[SORT_RADIX_SIZE];
+} sort_radix_job;
+
+static void *
+sort_radix_count(void *data) {
+  sort_radix_job *job = data;
+  memset(job->counts, 0, sizeof (job->counts));
+  for (u32 i = job->from; i < job->to; i++) {
+    job->counts[(job->keys[i] >> job->shift) & (SORT_RADIX_SIZE - 1)]++;
   }
-  return header + 1;
+  return 0;
 }
 
-void
-array_list_shift_left(void *arr, u32 index, u32 amount) {
-  if (amount == 0) return;
-  array_list_header *header = ARRAY_LIST_HEADER(arr);
-  if (amount > index) {
-    index = amount;
+/* `counts` holds the first output slot of every digit for this job. */
+static void *
+sort_radix_scatter(void *data) {
+  sort_radix_job *job = data;
+  for (u32 i = job->from; i < job->to; i++) {
+    u32 slot = job->counts[(job->keys[i] >> job->shift) & (SORT_RADIX_SIZE - 1)]++;
+    job->keys_out[slot]    = job->keys[i];
+    job->indexes_out[slot] = job->indexes[i];
   }
-  if (index >= header->size) return;
-  memmove(
-      (u8 *)arr + (index - amount) * header->type,
-      (u8 *)arr +  index           * header->type,
-      (header->size - index) * header->type);
+  return 0;
 }
 
-void
-array_list_shift_right(void *arr, u32 index, u32 amount) {
-  if (amount == 0) return;
-  array_list_header *header = ARRAY_LIST_HEADER(arr);
-  if (index + amount >= header->size) return;
-  memmove(
-      (u8 *)arr + (index + amount) * header->type,
-      (u8 *)arr +  index           * header->type,
-      (header->size - (index + amount)) * header->type);
+static void
+sort_radix_run(sort_radix_job *jobs, u32 threads, void *(*func)(void *)) {
+  pthread_t ids[SORT_THREADS];
+  b8 started[SORT_THREADS] = {0};
+  for (u32 t = 1; t < threads; t++) {
+    started[t] = pthread_create(&ids[t], 0, func, &jobs[t]) == 0;
+    if (!started[t]) func(&jobs[t]);
+  }
+  func(&jobs[0]);
+  for (u32 t = 1; t < threads; t++) {
+    if (started[t]) pthread_join(ids[t], 0);
+  }
 }
 
-#if 0
-void *
-array_list_push(void *arr, void *item) {
-  arr = array_list_grow(arr, 1);
-  array_list_header *header = ARRAY_LIST_HEADER(arr);
-  memcpy((u8 *)arr + header->type * (header->size - 1), item, header->type);
-  return arr;
+/* Bytes of the order returned by `sort_radix_order`, to free it. */
+#define SORT_ORDER_BYTES(AMOUNT) (sizeof (u32) * (u64)(AMOUNT) * 2)
+
+/* Stable LSD radix sort of the keys of `items`, returns the order the items must
+ * be placed in (`order[i]` is the index of the item that goes to `i`).
+ * The scratch memory and the order come from `allocator`. */
+static u32 *
+sort_radix_order(void *items, u32 amount, u32 stride, u32 key_offset, sort_key_type key, sort_flags flags,
+                 const blib_allocator *allocator) {
+  u64 *keys    = memory_alloc(allocator, MEMORY_TAG_OTHER, sizeof (u64) * amount * 2, BLIB_ALIGN);
+  u32 *indexes = memory_alloc(allocator, MEMORY_TAG_OTHER, SORT_ORDER_BYTES(amount), BLIB_ALIGN);
+  u64 *keys_tmp    = keys + amount;
+  u32 *indexes_tmp = indexes + amount;
+  u32 bits = key == SORT_KEY_U64 ? 64 : 32;
+  u64 flip = flags & SORT_DESCENDING ? (bits == 64 ? ~(u64)0 : 0xffffffffu) : 0;
+
+  u8 *item = (u8 *)items + key_offset;
+  for (u32 i = 0; i < amount; i++, item += stride) {
+    switch (key) {
+      case SORT_KEY_U32: { u32 k; memcpy(&k, item, sizeof (u32)); keys[i] = k; } break;
+      case SORT_KEY_F32: { f32 k; memcpy(&k, item, sizeof (f32)); keys[i] = sort_f32_key(k); } break;
+      case SORT_KEY_U64: { u64 k; memcpy(&k, item, sizeof (u64)); keys[i] = k; } break;
+    }
+    keys[i]   ^= flip;
+    indexes[i] = i;
+  }
+
+  u32 threads = (flags & SORT_PARALLEL) && amount >= SORT_PARALLEL_MIN ? SORT_THREADS : 1;
+  sort_radix_job jobs[SORT_THREADS];
+  for (u32 shift = 0; shift < bits && amount > 1; shift += SORT_RADIX_BITS) {
+    for (u32 t = 0; t < threads; t++) {
+      jobs[t].keys        = keys;
+      jobs[t].keys_out    = keys_tmp;
+      jobs[t].indexes     = indexes;
+      jobs[t].indexes_out = indexes_tmp;
+      jobs[t].from        = (u64)amount * t / threads;
+      jobs[t].to          = (u64)amount * (t + 1) / threads;
+      jobs[t].shift       = shift;
+    }
+    sort_radix_run(jobs, threads, sort_radix_count);
+
+    /* every key has the same digit, the pass wouldn't move anything */
+    u32 first = (keys[0] >> shift) & (SORT_RADIX_SIZE - 1);
+    u32 same  = 0;
+    for (u32 t = 0; t < threads; t++) same += jobs[t].counts[first];
+    if (same == amount) continue;
+
+    u32 offset = 0;
+    for (u32 d = 0; d < SORT_RADIX_SIZE; d++) {
+      for (u32 t = 0; t < threads; t++) {
+        u32 count = jobs[t].counts[d];
+        jobs[t].counts[d] = offset;
+        offset += count;
+      }
+    }
+    sort_radix_run(jobs, threads, sort_radix_scatter);
+
+    u64 *keys_swap = keys;
+    keys     = keys_tmp;
+    keys_tmp = keys_swap;
+    u32 *indexes_swap = indexes;
+    indexes     = indexes_tmp;
+    indexes_tmp = indexes_swap;
+  }
+
+  /* the order has to end up at the start of its buffer, that's the one being freed */
+  if (indexes > indexes_tmp) {
+    memcpy(indexes_tmp, indexes, sizeof (u32) * amount);
+    indexes = indexes_tmp;
+  }
+  memory_free(allocator, MEMORY_TAG_OTHER, keys < keys_tmp ? keys : keys_tmp, sizeof (u64) * amount * 2);
+  return indexes;
 }
 
-void *
-array_list_insert(void *arr, u32 index, void *item) {
-  array_list_header *header = ARRAY_LIST_HEADER(arr);
-  u32 max_index = header->size > 0 ? header->size - 1 : 0;
-  if (index > max_index) {
-    arr = array_list_grow(arr, index - max_index);
-    header = ARRAY_LIST_HEADER(arr);
-  } else {
-    arr = array_list_grow(arr, 1);
-    header = ARRAY_LIST_HEADER(arr);
-    memmove((u8 *)arr + header->type * (index + 1),
-            (u8 *)arr + header->type * (index),
-            (header->size - index) * header->type);
+/* Moves the items into `order`, `scratch` must fit all of them. */
+static void
+sort_permute(void *items, u32 amount, u32 stride, const u32 *order, u8 *scratch) {
+  for (u32 i = 0; i < amount; i++) {
+    memcpy(scratch + (u64)i * stride, (u8 *)items + (u64)order[i] * stride, stride);
   }
-  memcpy((u8 *)arr + header->type * index, item, header->type);
-  return arr;
+  memcpy(items, scratch, (u64)amount * stride);
 }
-#endif
 
-void
-array_list_pop(void *arr, void *out) {
-  array_list_header *header = ARRAY_LIST_HEADER(arr);
-  if (header->size == 0) return;
-  header->size--;
-  if (out)
-    memcpy(out, (u8 *)arr + header->type * header->size, header->type);
+/* `sort_radix` taking its scratch memory from `allocator`. */
+static void
+sort_radix_with(void *items, u32 amount, u32 stride, u32 key_offset, sort_key_type key, sort_flags flags,
+                const blib_allocator *allocator) {
+  if (amount < 2) return;
+  u32 *order   = sort_radix_order(items, amount, stride, key_offset, key, flags, allocator);
+  u8  *scratch = memory_alloc(allocator, MEMORY_TAG_OTHER, (u64)amount * stride, BLIB_ALIGN);
+  sort_permute(items, amount, stride, order, scratch);
+  memory_free(allocator, MEMORY_TAG_OTHER, scratch, (u64)amount * stride);
+  memory_free(allocator, MEMORY_TAG_OTHER, order, SORT_ORDER_BYTES(amount));
 }
 
 void
-array_list_remove(void *arr, u32 index, void *out) {
-  array_list_header *header = ARRAY_LIST_HEADER(arr);
-  if (header->size == 0 || index >= header->size) return;
-  if (out) memcpy(out, (u8 *)arr + header->type * index, header->type);
-  array_list_shift_left(arr, index + 1, 1);
-  header->size--;
+sort_radix(void *items, u32 amount, u32 stride, u32 key_offset, sort_key_type key, sort_flags flags) {
+  /* not from the open region, its arena only gives back the last allocation */
+  sort_radix_with(items, amount, stride, key_offset, key, flags, memory_base_allocator());
 }
 
 void
-array_list_clear(void *arr) {
+array_list_sort(void *arr, sort_compare compare) {
   array_list_header *header = ARRAY_LIST_HEADER(arr);
-   header->size = 0;
+  sort_intro(arr, header->size, header->type, compare);
 }
 
 void
-array_list_destroy(void *arr) {
-  free(ARRAY_LIST_HEADER(arr));
+array_list_sort_radix(void *arr, u32 key_offset, sort_key_type key, sort_flags flags) {
+  array_list_header *header = ARRAY_LIST_HEADER(arr);
+  sort_radix(arr, header->size, header->type, key_offset, key, flags);
 }
 
 /*
  *
- * *** Hash Table ***
+ * *** Hashing ***
  *
  * */
 
-static u32 hash_table_key_size[] = {
-  [HT_STR] = sizeof (str),
-  [HT_U64] = sizeof (u64),
-  [HT_U128] = sizeof (u128)
-};
+#define HASH_P1 UINT64_C(0x9e3779b185ebca87)
+#define HASH_P2 UINT64_C(0xc2b2ae3d27d4eb4f)
+#define HASH_P3 UINT64_C(0x165667b19e3779f9)
+#define HASH_P4 UINT64_C(0x85ebca77c2b2ae63)
+#define HASH_P5 UINT64_C(0x27d4eb2f165667c5)
 
-typedef union {
-  void *ptr;
-  str *str;
-  u64 *u64;
-  u128 *u128;
-} hash_table_key;
-
-struct hash_table {
-  hash_table_type key_type;
-  hash_table_key  keys;
-  b8             *free;
-  u8             *vals;
-  void           *buff;
-  u32             type;
-  u32             capa;
-  u32             size;
-};
+#define ROTL64(X, R) (((X) << (R)) | ((X) >> (64 - (R))))
 
-#define INITITAL_HASH_TABLE_CAP 17
+static inline u64
+hash_read_u64(const u8 *p) {
+  u64 x;
+  memcpy(&x, p, sizeof (u64));
+  return x;
+}
 
-static u32
-hash_str(str s) {
-  u32 hash = 5381;
-  for (u32 i = 0; i < s.size; i++) {
-    hash = ((hash << 5) + hash) + s.buff[i]; /* hash * 33 + c */
+static inline u32
+hash_read_u32(const u8 *p) {
+  u32 x;
+  memcpy(&x, p, sizeof (u32));
+  return x;
+}
+
+static inline u64
+hash_round(u64 acc, u64 input) {
+  acc += input * HASH_P2;
+  acc  = ROTL64(acc, 31);
+  return acc * HASH_P1;
+}
+
+static inline u64
+hash_merge_round(u64 acc, u64 val) {
+  acc ^= hash_round(0, val);
+  return acc * HASH_P1 + HASH_P4;
+}
+
+/* XXH64: 32 bytes stripes on four lanes, then 8, 4 and 1 byte steps. */
+u64
+hash_bytes(const void *data, u32 size) {
+  const u8 *p   = data;
+  const u8 *end = p + size;
+  u64 h;
+  if (size >= 32) {
+    const u8 *limit = end - 32;
+    u64 v1 = HASH_P1 + HASH_P2;
+    u64 v2 = HASH_P2;
+    u64 v3 = 0;
+    u64 v4 = -HASH_P1;
+    do {
+      v1 = hash_round(v1, hash_read_u64(p)); p += 8;
+      v2 = hash_round(v2, hash_read_u64(p)); p += 8;
+      v3 = hash_round(v3, hash_read_u64(p)); p += 8;
+      v4 = hash_round(v4, hash_read_u64(p)); p += 8;
+    } while (p <= limit);
+    h = ROTL64(v1, 1) + ROTL64(v2, 7) + ROTL64(v3, 12) + ROTL64(v4, 18);
+    h = hash_merge_round(h, v1);
+    h = hash_merge_round(h, v2);
+    h = hash_merge_round(h, v3);
+    h = hash_merge_round(h, v4);
+  } else {
+    h = HASH_P5;
   }
-  return hash;
+  h += size;
+  for (; p + 8 <= end; p += 8) {
+    h ^= hash_round(0, hash_read_u64(p));
+    h  = ROTL64(h, 27) * HASH_P1 + HASH_P4;
+  }
+  if (p + 4 <= end) {
+    h ^= (u64)hash_read_u32(p) * HASH_P1;
+    h  = ROTL64(h, 23) * HASH_P2 + HASH_P3;
+    p += 4;
+  }
+  for (; p < end; p++) {
+    h ^= (*p) * HASH_P5;
+    h  = ROTL64(h, 11) * HASH_P1;
+  }
+  h ^= h >> 33;
+  h *= HASH_P2;
+  h ^= h >> 29;
+  h *= HASH_P3;
+  h ^= h >> 32;
+  return h;
 }
 
-static u32
+u64
+hash_str(str s) {
+  return hash_bytes(s.buff, s.size);
+}
+
+u64
 hash_u64(u64 x) {
   x = (x ^ (x >> 30)) * UINT64_C(0xbf58476d1ce4e5b9);
   x = (x ^ (x >> 27)) * UINT64_C(0x94d049bb133111eb);
@@ -474,13 +2531,55 @@ hash_u64(u64 x) {
   return x;
 }
 
-static u32
+u64
 hash_u128(u128 x) {
-  return hash_u64(x.u64[0]) | hash_u64(x.u64[1]);
+  /* the high half is fully mixed before being folded into the low one,
+   * so keys differing only on one half still spread over every bit */
+  return hash_u64(x.u64[0] ^ (hash_u64(x.u64[1]) + HASH_P1));
+}
+
+#undef ROTL64
+
+/*
+ *
+ * *** Hash Table ***
+ *
+ * */
+
+static u32 hash_table_key_size[] = {
+  [HT_STR] = sizeof (str),
+  [HT_U64] = sizeof (u64),
+  [HT_U128] = sizeof (u128),
+  [HT_U32] = sizeof (u32),
+  [HT_BYTES] = 0
+};
+
+#define INITITAL_HASH_TABLE_CAP HASH_TABLE_GROUP
+
+#ifdef __GNUC__
+#define PREFETCH(P) __builtin_prefetch(P)
+#else
+#define PREFETCH(P) ((void)(P))
+#endif
+
+/* Keys hashed and prefetched ahead of the probes by `hash_table_get_batch`. */
+#define HASH_TABLE_BATCH 16
+
+#ifdef BLIB_CONTAINER_STATS
+/* Records a lookup that probed `groups` groups. */
+static inline void
+hash_table_stats_probe(hash_table *ht, u32 groups) {
+  ht->stats.lookups++;
+  ht->stats.probes[MIN(groups, HASH_TABLE_STATS_PROBES) - 1]++;
+  ht->stats.max_probe = MAX(ht->stats.max_probe, groups);
 }
+#define HASH_TABLE_STATS_PROBE(HT, GROUPS) hash_table_stats_probe(HT, GROUPS)
+#else
+#define HASH_TABLE_STATS_PROBE(HT, GROUPS) ((void)0)
+#endif
 
 static u32
-hash(hash_table *ht, void *key) {
+hash_table_hash(hash_table *ht, void *key) {
   switch (ht->key_type) {
     case HT_STR:
       return hash_str(*(str *)key);
@@ -488,55 +2587,266 @@ hash(hash_table *ht, void *key) {
       return hash_u64(*(u64 *)key);
     case HT_U128:
       return hash_u128(*(u128 *)key);
+    case HT_U32:
+      return hash_u64(*(u32 *)key);
+    case HT_BYTES:
+      return ht->key_hash ? ht->key_hash(key, ht->key_size) : hash_bytes(key, ht->key_size);
     case HT_AMOUNT:
-      err("hash(): unreachable\n");
+      err("hash_table_hash(): unreachable\n");
       exit(1);
   }
   return 0;
 }
 
+static inline b8
+hash_table_key_equal(hash_table *ht, u32 index, void *key) {
+  switch (ht->key_type) {
+    case HT_STR:
+      return string_equal(ht->keys.str[index], *(str *)key);
+    case HT_U64:
+      return ht->keys.u64[index] == *(u64 *)key;
+    case HT_U128:
+      return ht->keys.u128[index].u64[0] == ((u128 *)key)->u64[0] &&
+             ht->keys.u128[index].u64[1] == ((u128 *)key)->u64[1];
+    case HT_U32:
+      return ht->keys.u32[index] == *(u32 *)key;
+    case HT_BYTES:
+      return ht->key_equal ?
+        ht->key_equal(ht->keys.bytes + index * ht->key_size, key, ht->key_size) :
+        !memcmp(ht->keys.bytes + index * ht->key_size, key, ht->key_size);
+    case HT_AMOUNT: break;
+  }
+  return false;
+}
+
+/* Offsets of the arrays of a buffer of `CAPA` slots, each one starts on a cache line. */
+#define HASH_TABLE_HASHES_OFFSET(CAPA)   ALIGN_UP((u64)(CAPA) * sizeof (u8), BLIB_ALIGN)
+#define HASH_TABLE_KEYS_OFFSET(CAPA)     ALIGN_UP(HASH_TABLE_HASHES_OFFSET(CAPA) + (u64)(CAPA) * sizeof (u32), BLIB_ALIGN)
+#define HASH_TABLE_VALS_OFFSET(HT, CAPA) ALIGN_UP(HASH_TABLE_KEYS_OFFSET(CAPA) + (u64)(CAPA) * (HT)->key_size, BLIB_ALIGN)
+#define HASH_TABLE_BUFF_SIZE(HT, CAPA)   (HASH_TABLE_VALS_OFFSET(HT, CAPA) + (u64)(CAPA) * (HT)->type)
+
+/* Points the ctrl, keys and vals arrays into a new buffer of `capa` slots with every slot empty. */
+static void
+hash_table_alloc(hash_table *ht, u32 capa) {
+  ht->capa     = capa;
+  ht->buff     = memory_alloc(ht->allocator, ht->tag, HASH_TABLE_BUFF_SIZE(ht, capa), BLIB_ALIGN);
+  ht->ctrl     = ht->buff;
+  ht->hashes   = (u32 *)(ht->ctrl + HASH_TABLE_HASHES_OFFSET(capa));
+  ht->keys.ptr = ht->ctrl + HASH_TABLE_KEYS_OFFSET(capa);
+  ht->vals     = ht->ctrl + HASH_TABLE_VALS_OFFSET(ht, capa);
+  ht->deleted  = 0;
+  memset(ht->ctrl, HASH_TABLE_EMPTY, capa);
+}
+
+/* Returns the index of `key` or HASH_TABLE_NONE if it isn't on the table.
+ * The groups are probed with triangular steps, which visits every group once
+ * since the amount of groups is a power of two. */
+static u32
+hash_table_find(hash_table *ht, void *key, u32 hash) {
+  u32 groups_mask = ht->capa / HASH_TABLE_GROUP - 1;
+  u32 group = HASH_TABLE_H1(hash) & groups_mask;
+  u8  h2    = HASH_TABLE_H2(hash);
+  for (u32 probe = 0; probe <= groups_mask; probe++) {
+    const u8 *ctrl = ht->ctrl + group * HASH_TABLE_GROUP;
+    for (u32 match = hash_table_group_match(ctrl, h2); match; match &= match - 1) {
+      u32 index = group * HASH_TABLE_GROUP + CTZ32(match);
+      if (ht->hashes[index] == hash && hash_table_key_equal(ht, index, key)) {
+        HASH_TABLE_STATS_PROBE(ht, probe + 1);
+        return index;
+      }
+    }
+    if (hash_table_group_match_empty(ctrl)) {
+      HASH_TABLE_STATS_PROBE(ht, probe + 1);
+      return HASH_TABLE_NONE;
+    }
+    group = (group + probe + 1) & groups_mask;
+  }
+  HASH_TABLE_STATS_PROBE(ht, groups_mask + 1);
+  return HASH_TABLE_NONE;
+}
+
+/* Copies a string key. The keys of a table on the base allocator go to the
+ * strings pool like any string, the ones of a table on another allocator (a
+ * region's) come from it too, so resetting the region frees them with the table. */
+static str
+hash_table_key_create(hash_table *ht, str key) {
+  if (ht->allocator == memory_base_allocator()) return string_create(key);
+  str copy;
+  copy.size = key.size;
+  copy.capa = key.size + 1;
+  copy.buff = memory_alloc(ht->allocator, MEMORY_TAG_STRINGS, copy.capa, 1);
+  memcpy(copy.buff, key.buff, key.size);
+  copy.buff[key.size] = '\0';
+  return copy;
+}
+
+static void
+hash_table_key_destroy(hash_table *ht, str key) {
+  if (ht->allocator == memory_base_allocator()) string_destroy(key);
+  else memory_free(ht->allocator, MEMORY_TAG_STRINGS, key.buff, key.capa);
+}
+
+/* Moves all the entries into a new buffer of `capa` slots, dropping the deleted ones.
+ * The keys and the stored hashes are moved as they are, so the new buffer
+ * is the only allocation and no key is hashed or duplicated again. */
+static void
+hash_table_resize(hash_table *ht, u32 capa) {
+  u32             old_capa = ht->capa;
+  void           *old_buff = ht->buff;
+  u8             *old_ctrl = ht->ctrl;
+  u32            *old_hash = ht->hashes;
+  hash_table_key  old_keys = ht->keys;
+  u8             *old_vals = ht->vals;
+  u32             key_size = ht->key_size;
+#ifdef BLIB_CONTAINER_STATS
+  clock_t         start    = clock();
+#endif
+
+  hash_table_alloc(ht, capa);
+  for (u32 i = 0; i < old_capa; i++) {
+    if (old_ctrl[i] & HASH_TABLE_EMPTY) continue;
+    u32 index = hash_table_find_free(ht, old_hash[i]);
+    ht->ctrl[index]   = old_ctrl[i];
+    ht->hashes[index] = old_hash[i];
+    memcpy((u8 *)ht->keys.ptr + index * key_size, (u8 *)old_keys.ptr + i * key_size, key_size);
+    memcpy(ht->vals + index * ht->type, old_vals + i * ht->type, ht->type);
+  }
+  memory_free(ht->allocator, ht->tag, old_buff, HASH_TABLE_BUFF_SIZE(ht, old_capa));
+#ifdef BLIB_CONTAINER_STATS
+  ht->stats.resizes++;
+  ht->stats.resize_time += (f64)(clock() - start) / CLOCKS_PER_SEC;
+#endif
+}
+
+void
+hash_table_grow(hash_table *ht) {
+  /* when most of the load are deleted slots a rehash with the same capacity is enough */
+  hash_table_resize(ht, ht->size + 1 > ht->capa / 2 ? ht->capa * 2 : ht->capa);
+}
+
+/* Creates a hash table whose memory is counted as `tag`'s. */
+static hash_table *
+hash_table_create_tagged(u32 type_size, hash_table_type key_type, const blib_allocator *allocator, memory_tag tag) {
+  if (key_type == HT_BYTES) {
+    err("hash_table_create(): HT_BYTES hash tables are created with hash_table_create_bytes()\n");
+    exit(1);
+  }
+  hash_table *ht = memory_alloc(allocator, tag, sizeof (hash_table), BLIB_ALIGN);
+  ht->allocator = allocator;
+  ht->tag       = tag;
+  ht->key_type  = key_type;
+  ht->key_size  = hash_table_key_size[key_type];
+  ht->key_hash  = 0;
+  ht->key_equal = 0;
+  ht->size = 0;
+  ht->type = type_size;
+#ifdef BLIB_CONTAINER_STATS
+  memset(&ht->stats, 0, sizeof (hash_table_stats));
+#endif
+  hash_table_alloc(ht, INITITAL_HASH_TABLE_CAP);
+  return ht;
+}
+
+hash_table *
+hash_table_create_with(u32 type_size, hash_table_type key_type, const blib_allocator *allocator) {
+  return hash_table_create_tagged(type_size, key_type, allocator, MEMORY_TAG_HASH_TABLES);
+}
+
 hash_table *
 hash_table_create(u32 type_size, hash_table_type key_type) {
-  hash_table *ht = malloc(sizeof (hash_table));
-  ht->key_type = key_type;
-  ht->capa = INITITAL_HASH_TABLE_CAP;
+  return hash_table_create_with(type_size, key_type, blib_get_allocator());
+}
+
+static hash_table *
+hash_table_create_bytes_tagged(u32 type_size, u32 key_size, hash_table_hash_func hash, hash_table_equal_func equal,
+    const blib_allocator *allocator, memory_tag tag) {
+  hash_table *ht = memory_alloc(allocator, tag, sizeof (hash_table), BLIB_ALIGN);
+  ht->allocator = allocator;
+  ht->tag       = tag;
+  ht->key_type  = HT_BYTES;
+  ht->key_size  = key_size;
+  ht->key_hash  = hash;
+  ht->key_equal = equal;
   ht->size = 0;
   ht->type = type_size;
-  ht->buff = malloc((sizeof (b8) + hash_table_key_size[key_type] + type_size) * ht->capa);
-  ht->free     = (b8 *)ht->buff;
-  ht->keys.ptr = (u8 *)ht->free     + sizeof (b8)                   * ht->capa;
-  ht->vals     = (u8 *)ht->keys.ptr + hash_table_key_size[key_type] * ht->capa;
-  memset(ht->free, true, sizeof (b8) * ht->capa);
+#ifdef BLIB_CONTAINER_STATS
+  memset(&ht->stats, 0, sizeof (hash_table_stats));
+#endif
+  hash_table_alloc(ht, INITITAL_HASH_TABLE_CAP);
   return ht;
 }
 
+hash_table *
+hash_table_create_bytes(u32 type_size, u32 key_size, hash_table_hash_func hash, hash_table_equal_func equal) {
+  return hash_table_create_bytes_tagged(type_size, key_size, hash, equal, blib_get_allocator(), MEMORY_TAG_HASH_TABLES);
+}
+
+void
+hash_table_reserve(hash_table *ht, u32 amount) {
+  u32 capa = ht->capa;
+  amount = MAX(amount, ht->size);
+  while (HASH_TABLE_MAX_LOAD(capa) < amount) capa *= 2;
+  /* the deleted slots count against the load too, a rehash drops them */
+  if (capa != ht->capa || amount + ht->deleted > HASH_TABLE_MAX_LOAD(capa)) hash_table_resize(ht, capa);
+}
+
 void *
 hash_table_get(hash_table *ht, void *key) {
-  u32 index = hash(ht, key) % ht->capa;
-  while (!ht->free[index]) {
-    switch (ht->key_type) {
-      case HT_STR:
-        if (string_equal(ht->keys.str[index], *(str *)key))
-          return ht->vals + (index * ht->type);
-        break;
-      case HT_U64:
-        if (ht->keys.u64[index] == *(u64 *)key)
-          return ht->vals + (index * ht->type);
-        break;
-      case HT_U128:
-        if (ht->keys.u128[index].u64[0] == ((u128 *)key)->u64[0] &&
-            ht->keys.u128[index].u64[1] == ((u128 *)key)->u64[1])
-          return ht->vals + (index * ht->type);
+  u32 index = hash_table_find(ht, key, hash_table_hash(ht, key));
+  if (index == HASH_TABLE_NONE) return 0;
+  return ht->vals + index * ht->type;
+}
+
+/* All the keys of a batch are hashed and their first group prefetched before
+ * any probe, then the slot matching each hash gets its key and value
+ * prefetched before any key compare, so the cache misses of the batch
+ * overlap instead of adding up. */
+void
+hash_table_get_batch(hash_table *ht, const void *keys, u32 amount, void **out_vals) {
+  u32 groups_mask = ht->capa / HASH_TABLE_GROUP - 1;
+  u32 hashes[HASH_TABLE_BATCH];
+  u32 slots[HASH_TABLE_BATCH];
+  for (u32 begin = 0; begin < amount; begin += HASH_TABLE_BATCH) {
+    u32 count = MIN(HASH_TABLE_BATCH, amount - begin);
+    u8 *batch = (u8 *)keys + begin * ht->key_size;
+    for (u32 i = 0; i < count; i++) {
+      hashes[i] = hash_table_hash(ht, batch + i * ht->key_size);
+      u32 group = HASH_TABLE_H1(hashes[i]) & groups_mask;
+      PREFETCH(ht->ctrl   + group * HASH_TABLE_GROUP);
+      PREFETCH(ht->hashes + group * HASH_TABLE_GROUP);
+    }
+    for (u32 i = 0; i < count; i++) {
+      u32 group = HASH_TABLE_H1(hashes[i]) & groups_mask;
+      slots[i] = HASH_TABLE_NONE;
+      for (u32 match = hash_table_group_match(ht->ctrl + group * HASH_TABLE_GROUP, HASH_TABLE_H2(hashes[i])); match; match &= match - 1) {
+        u32 index = group * HASH_TABLE_GROUP + CTZ32(match);
+        if (ht->hashes[index] != hashes[i]) continue;
+        slots[i] = index;
+        PREFETCH(ht->keys.bytes + index * ht->key_size);
+        PREFETCH(ht->vals       + index * ht->type);
         break;
-      case HT_AMOUNT: break;
+      }
+    }
+    for (u32 i = 0; i < count; i++) {
+      u32 index = slots[i];
+      /* the key wasn't on its first group or it was a hash collision */
+      if (index == HASH_TABLE_NONE || !hash_table_key_equal(ht, index, batch + i * ht->key_size)) {
+        index = hash_table_find(ht, batch + i * ht->key_size, hashes[i]);
+      } else {
+        HASH_TABLE_STATS_PROBE(ht, 1);
+      }
+      out_vals[begin + i] = index == HASH_TABLE_NONE ? 0 : ht->vals + index * ht->type;
     }
-    index = (index + 1) % ht->capa;
   }
-  return 0;
 }
 
 void
 hash_table_value_key(hash_table *ht, void *val, void *out_key) {
+  if (!ht->type) {
+    /* the values of a set take no room, every pointer to them is the same */
+    wrn("hash_table_value_key(): the table has no values\n");
+    return;
+  }
   if (ht->vals > (u8 *)val || ht->vals + ht->capa * ht->type <= (u8 *)val) {
     wrn("hash_table_value_key(): invalid value\n");
     return;
@@ -547,7 +2857,7 @@ hash_table_value_key(hash_table *ht, void *val, void *out_key) {
     return;
   }
   index /= ht->type;
-  memcpy(out_key, (u8 *)ht->keys.ptr + index * hash_table_key_size[ht->key_type], hash_table_key_size[ht->key_type]);
+  memcpy(out_key, ht->keys.bytes + index * ht->key_size, ht->key_size);
 }
 
 void *
@@ -556,76 +2866,36 @@ hash_table_add(hash_table *ht, void *key) {
     wrn("hash_table_add(): the key cannot be NULL\n");
     return 0;
   }
-  f32 load_factor = (f32)ht->size / (f32)ht->capa;
-  if (load_factor >= 0.5f) {
-    u32 old_capa = ht->capa;
-    ht->capa *= 2;
-    void *old_buff = malloc((sizeof (str) + ht->type) * old_capa);
-    memcpy(old_buff, ht->buff, (sizeof (str) + ht->type) * old_capa);
-    b8             *old_free = old_buff;
-    hash_table_key  old_keys = { (u8 *)old_free     + sizeof (b8)                       * ht->capa };
-    u8             *old_vals =   (u8 *)old_keys.ptr + hash_table_key_size[ht->key_type] * old_capa;
-
-    ht->buff = realloc(ht->buff, (sizeof (b8) + hash_table_key_size[ht->key_type] + ht->type) * ht->capa);
-    ht->free     = (b8 *)ht->buff;
-    ht->keys.ptr = (u8 *)ht->free     + sizeof (b8)                       * ht->capa;
-    ht->vals     = (u8 *)ht->keys.ptr + hash_table_key_size[ht->key_type] * ht->capa;
-    memset(ht->free, true, sizeof (b8) * ht->capa);
-
-    for (u32 i = 0; i < old_capa; i++) {
-      if (!old_free[i]) continue;
-      u32 index = hash(ht, (u8 *)old_keys.ptr + i * hash_table_key_size[ht->key_type]) % ht->capa;
-      while (!ht->free[index]) {
-        index = (index + 1) % ht->capa;
-      }
-      switch (ht->key_type) {
-        case HT_STR:
-          ht->keys.str[index] = string_create(old_keys.str[i]);
-          break;
-        case HT_U64:
-          ht->keys.u64[index] = old_keys.u64[i];
-          break;
-        case HT_U128:
-          ht->keys.u128[index] = old_keys.u128[i];
-          break;
-        case HT_AMOUNT: break;
-      }
-      memcpy(ht->vals + ht->type * index, old_vals + ht->type * i, ht->type);
-      ht->free[index] = false;
-    }
-
-    free(old_buff);
-  }
-
-  u32 index = hash(ht, key) % ht->capa;
-  while (!ht->free[index]) {
+  u32 h = hash_table_hash(ht, key);
+  if (hash_table_find(ht, key, h) != HASH_TABLE_NONE) {
     switch (ht->key_type) {
       case HT_STR:
-        if (string_equal(ht->keys.str[index], *(str *)key)) {
-          wrn("hash_table_add(): the key '%.*s' is already on the hash table\n", ((str *)key)->size, ((str *)key)->buff);
-          return 0;
-        }
+        wrn("hash_table_add(): the key '%.*s' is already on the hash table\n", ((str *)key)->size, ((str *)key)->buff);
         break;
       case HT_U64:
-        if (ht->keys.u64[index] == *(u64 *)key) {
-          wrn("hash_table_add(): the key '%lu' is already on the hash table\n", *(u64 *)key);
-          return 0;
-        }
+        wrn("hash_table_add(): the key '%lu' is already on the hash table\n", *(u64 *)key);
         break;
       case HT_U128:
-        if (ht->keys.u128[index].u64[0] == ((u128 *)key)->u64[0] &&
-            ht->keys.u128[index].u64[1] == ((u128 *)key)->u64[1]) {
-          wrn("hash_table_add(): the key '%lu%lu' is already on the hash table\n", ((u128 *)key)->u64[1], ((u128 *)key)->u64[0]);
-          return 0;
-        }
+        wrn("hash_table_add(): the key '%lu%lu' is already on the hash table\n", ((u128 *)key)->u64[1], ((u128 *)key)->u64[0]);
+        break;
+      case HT_U32:
+        wrn("hash_table_add(): the key '%u' is already on the hash table\n", *(u32 *)key);
+        break;
+      case HT_BYTES:
+        wrn("hash_table_add(): the key is already on the hash table\n");
         break;
       case HT_AMOUNT: break;
     }
-    index = (index + 1) % ht->capa;
+    return 0;
   }
+  if (ht->size + ht->deleted + 1 > HASH_TABLE_MAX_LOAD(ht->capa)) hash_table_grow(ht);
+  u32 index = hash_table_find_free(ht, h);
+  if (ht->ctrl[index] == HASH_TABLE_DELETED) ht->deleted--;
+  ht->ctrl[index]   = HASH_TABLE_H2(h);
+  ht->hashes[index] = h;
   switch (ht->key_type) {
     case HT_STR:
-      ht->keys.str[index] = string_create(*(str *)key);
+      ht->keys.str[index] = hash_table_key_create(ht, *(str *)key);
       break;
     case HT_U64:
       ht->keys.u64[index] = *(u64 *)key;
@@ -633,84 +2903,196 @@ hash_table_add(hash_table *ht, void *key) {
     case HT_U128:
       ht->keys.u128[index] = *(u128 *)key;
       break;
+    case HT_U32:
+      ht->keys.u32[index] = *(u32 *)key;
+      break;
+    case HT_BYTES:
+      memcpy(ht->keys.bytes + index * ht->key_size, key, ht->key_size);
+      break;
     case HT_AMOUNT: break;
   }
   ht->size++;
-  ht->free[index] = false;
   return ht->vals + index * ht->type;
 }
 
 void
 hash_table_del(hash_table *ht, void *key) {
-  u32 index = hash(ht, key) % ht->capa;
-  while (!ht->free[index]) {
+  u32 index = hash_table_find(ht, key, hash_table_hash(ht, key));
+  if (index == HASH_TABLE_NONE) {
     switch (ht->key_type) {
       case HT_STR:
-        if (string_equal(ht->keys.str[index], *(str *)key)) {
-          string_destroy(ht->keys.str[index]);
-          ht->free[index] = true;
-          ht->size--;
-          return;
-        }
+        wrn("hash_table_del(): the key '%.*s' doesn't exists\n", ((str *)key)->size, ((str *)key)->buff);
         break;
       case HT_U64:
-        if (ht->keys.u64[index] == *(u64 *)key) {
-          ht->free[index] = true;
-          ht->size--;
-          return;
-        }
+        wrn("hash_table_del(): the key '%lu' doesn't exists\n", *(u64 *)key);
         break;
       case HT_U128:
-        if (ht->keys.u128[index].u64[0] == ((u128 *)key)->u64[0] &&
-            ht->keys.u128[index].u64[1] == ((u128 *)key)->u64[1]) {
-          ht->free[index] = true;
-          ht->size--;
-          return;
-        }
+        wrn("hash_table_del(): the key '%lu%lu' doesn't exists\n", ((u128 *)key)->u64[1], ((u128 *)key)->u64[0]);
+        break;
+      case HT_U32:
+        wrn("hash_table_del(): the key '%u' doesn't exists\n", *(u32 *)key);
+        break;
+      case HT_BYTES:
+        wrn("hash_table_del(): the key doesn't exists\n");
         break;
       case HT_AMOUNT: break;
     }
-    index = (index + 1) % ht->capa;
+    return;
   }
-  switch (ht->key_type) {
-    case HT_STR:
-      if (string_equal(ht->keys.str[index], *(str *)key))
-        wrn("hash_table_del(): the key '%.*s' doesn't exists", ((str *)key)->size, ((str *)key)->buff);
-      return;
-    case HT_U64:
-      if (ht->keys.u64[index] == *(u64 *)key)
-        wrn("hash_table_del(): the key '%lu' doesn't exists", *(u64 *)key);
-      return;
-    case HT_U128:
-      if (ht->keys.u128[index].u64[0] == ((u128 *)key)->u64[0] &&
-          ht->keys.u128[index].u64[1] == ((u128 *)key)->u64[1])
-        wrn("hash_table_del(): the key '%lu' doesn't exists", *(u64 *)key);
-      return;
-    case HT_AMOUNT: return;
+  if (ht->key_type == HT_STR) hash_table_key_destroy(ht, ht->keys.str[index]);
+  /* A probe only goes past a group that has no empty slots, so if the group
+   * still has one no probe sequence depends on this slot being occupied. */
+  if (hash_table_group_match_empty(ht->ctrl + index / HASH_TABLE_GROUP * HASH_TABLE_GROUP)) {
+    ht->ctrl[index] = HASH_TABLE_EMPTY;
+  } else {
+    ht->ctrl[index] = HASH_TABLE_DELETED;
+    ht->deleted++;
+  }
+  ht->size--;
+}
+
+void
+hash_table_clear(hash_table *ht) {
+  if (ht->key_type == HT_STR) {
+    for (u32 i = 0; i < ht->capa; i++) {
+      if (ht->ctrl[i] & HASH_TABLE_EMPTY) continue;
+      hash_table_key_destroy(ht, ht->keys.str[i]);
+    }
+  }
+  ht->size    = 0;
+  ht->deleted = 0;
+  memset(ht->ctrl, HASH_TABLE_EMPTY, ht->capa);
+}
+
+void
+hash_table_destroy(hash_table *ht) {
+  hash_table_clear(ht);
+  memory_free(ht->allocator, ht->tag, ht->buff, HASH_TABLE_BUFF_SIZE(ht, ht->capa));
+  memory_free(ht->allocator, ht->tag, ht, sizeof (hash_table));
+}
+
+hash_table_stats
+hash_table_get_stats(hash_table *ht) {
+#ifdef BLIB_CONTAINER_STATS
+  hash_table_stats stats = ht->stats;
+#else
+  hash_table_stats stats = { 0 };
+#endif
+  stats.size       = ht->size;
+  stats.capacity   = ht->capa;
+  stats.tombstones = ht->deleted;
+  return stats;
+}
+
+void
+hash_table_stats_dump(hash_table *ht, ccstr name) {
+  hash_table_stats stats = hash_table_get_stats(ht);
+  inf("hash table '%s': size %u, capacity %u, load %.2f, tombstones %u, resizes %u (%.3f ms)\n",
+      name, stats.size, stats.capacity, (f32)stats.size / stats.capacity, stats.tombstones,
+      stats.resizes, stats.resize_time * 1000.0);
+  if (!stats.lookups) return;
+  inf("hash table '%s': %lu lookups, max probe %u groups, probed groups:", name,
+      (unsigned long)stats.lookups, stats.max_probe);
+  for (u32 i = 0; i < HASH_TABLE_STATS_PROBES; i++) {
+    if (stats.probes[i]) fprintf(stderr, " %s%u: %.2f%%", i == HASH_TABLE_STATS_PROBES - 1 ? ">=" : "", i + 1, stats.probes[i] * 100.0 / stats.lookups);
   }
+  fprintf(stderr, "\n");
+}
+
+/*
+ * *** Atoms ***
+ * */
+
+/* The interned strings are keyed by their hash and contents. */
+typedef struct {
+  u64 hash;
+  str name;
+} atom_key;
+
+/* FNV-1a only mixes upwards, the table needs every bit mixed */
+#define ATOM_KEY_HASH(K) hash_u64((K).hash)
+
+static inline b8
+atom_key_equal(atom_key a, atom_key b) {
+  return a.hash == b.hash && string_equal(a.name, b.name);
 }
 
-void
-hash_table_clear(hash_table *ht) {
-  ht->size = 0;
-  memset(ht->free, true, ht->capa);
+HASH_TABLE_SETUP(atom_table, atom_key, atom, ATOM_KEY_HASH, atom_key_equal)
+
+static struct {
+  hash_table *table;  /* atom_key to atom, created on first use */
+  arena      *chars;  /* the interned strings, they never move */
+  str        *names;  /* the string of every atom */
+  u64        *hashes; /* the hash of every atom */
+} atoms;
+
+/* Atoms live as long as the program so they never come from a region. */
+static void
+atoms_init(void) {
+  const blib_allocator *allocator = memory_base_allocator();
+  atoms.table  = hash_table_create_bytes_tagged(sizeof (atom), sizeof (atom_key),
+      atom_table_hash_key, atom_table_equal_key, allocator, MEMORY_TAG_STRINGS);
+  atoms.chars  = arena_create_with(1024, allocator, MEMORY_TAG_STRINGS);
+  atoms.names  = array_list_create_tagged(sizeof (str), allocator, MEMORY_TAG_STRINGS);
+  atoms.hashes = array_list_create_tagged(sizeof (u64), allocator, MEMORY_TAG_STRINGS);
+  /* ATOM_NONE is the empty string */
+  array_list_push(atoms.names,  STR_0);
+  array_list_push(atoms.hashes, atom_hash_str(STR_0));
 }
 
-void
-hash_table_destroy(hash_table *ht) {
-  switch (ht->key_type) {
-    case HT_STR:
-      for (u32 i = 0; i < ht->capa; i++) {
-        if (ht->free[i]) continue;
-        string_destroy(ht->keys.str[i]);
-      }
-      break;
-    case HT_U64:     break;
-    case HT_U128:    break;
-    case HT_AMOUNT:  break;
+u64
+atom_hash_str(str s) {
+  u64 hash = ATOM_HASH_OFFSET;
+  for (u32 i = 0; i < s.size; i++) hash = (hash ^ (u8)s.buff[i]) * ATOM_HASH_PRIME;
+  return hash;
+}
+
+atom
+atom_intern_hashed(str s, u64 hash) {
+  if (!s.size) return ATOM_NONE;
+  if (!atoms.table) atoms_init();
+  atom *found = atom_table_get(atoms.table, (atom_key) { hash, s });
+  if (found) return *found;
+  str name = { .size = s.size, .capa = 0, .buff = arena_alloc(atoms.chars, s.size + 1, 1) };
+  memcpy(name.buff, s.buff, s.size);
+  name.buff[s.size] = '\0';
+  atom a = array_list_size(atoms.names);
+  array_list_push(atoms.names,  name);
+  array_list_push(atoms.hashes, hash);
+  *atom_table_add(atoms.table, (atom_key) { hash, name }) = a;
+  return a;
+}
+
+atom
+atom_intern(str s) {
+  return atom_intern_hashed(s, atom_hash_str(s));
+}
+
+atom
+atom_find(str s) {
+  if (!s.size || !atoms.table) return ATOM_NONE;
+  atom *found = atom_table_get(atoms.table, (atom_key) { atom_hash_str(s), s });
+  return found ? *found : ATOM_NONE;
+}
+
+str
+atom_str(atom a) {
+  if (!atoms.table) atoms_init();
+  if (a >= array_list_size(atoms.names)) {
+    wrn("atom_str(): invalid atom '%u'\n", a);
+    return STR_0;
   }
-  free(ht->buff);
-  free(ht);
+  return atoms.names[a];
+}
+
+u64
+atom_hash(atom a) {
+  if (!atoms.table) atoms_init();
+  if (a >= array_list_size(atoms.hashes)) {
+    wrn("atom_hash(): invalid atom '%u'\n", a);
+    return atom_hash_str(STR_0);
+  }
+  return atoms.hashes[a];
 }
 
 /*
@@ -728,56 +3110,112 @@ hash_table_destroy(hash_table *ht) {
 
 static void
 entity_system_init(void) {
-  entity_system.new_type          = 0;
-  entity_system.entities          = hash_table_create(sizeof (entity_type), HT_STR);
-  entity_system.entity_type_names = array_list_create(sizeof (str));
+  entity_system.new_type = 0;
+  entity_system.entities = hash_table_create_tagged(sizeof (entity_type_id), HT_U32,
+      memory_base_allocator(), MEMORY_TAG_ENTITY_SYSTEM);
+  entity_system.types    = array_list_create_tagged(sizeof (entity_type),
+      memory_base_allocator(), MEMORY_TAG_ENTITY_SYSTEM);
 }
 
-void
+/* An entity type id is the slot of the type on the low bits and its generation
+ * on the high ones, so the ids of destroyed types don't find the next one in it. */
+#define ENTITY_TYPE_SLOTS                0xffff /* the slot of ENTITY_TYPE_NONE is never used */
+#define ENTITY_TYPE_ID(SLOT, GENERATION) ((SLOT) | (GENERATION) << 16)
+#define ENTITY_TYPE_SLOT(ID)             ((ID) & 0xffff)
+#define ENTITY_TYPE_GENERATION(ID)       ((ID) >> 16)
+
+/* Returns the entity type `id`, NULL if it doesn't exist. */
+static inline entity_type *
+entity_type_get(entity_type_id id) {
+  u32 slot = ENTITY_TYPE_SLOT(id);
+  if (slot >= array_list_size(entity_system.types)) return 0;
+  entity_type *type = &entity_system.types[slot];
+  if (!type->name || type->generation != ENTITY_TYPE_GENERATION(id)) return 0;
+  return type;
+}
+
+/* Returns the entity type named `name`, NULL if it doesn't exist. */
+static inline entity_type *
+entity_type_get_atom(atom name) {
+  entity_type_id *id = hash_table_get(entity_system.entities, &name);
+  return id ? &entity_system.types[ENTITY_TYPE_SLOT(*id)] : 0;
+}
+
+/* Returns the component `name` of `type`, NULL if it doesn't have it. */
+static inline entity_component *
+entity_type_component_atom(entity_type *type, atom name) {
+  component_id *id = hash_table_get(type->component_ids, &name);
+  return id ? &type->components[*id] : 0;
+}
+
+entity_type_id
 entity_type_begin(str name) {
   if (entity_system.new_type) {
     wrn("entity_type_begin(): trying to create two entity types at the same time. forgot entity_type_end()?\n");
-    return;
+    return ENTITY_TYPE_NONE;
   }
   if (!name.size) {
     wrn("entity_type_begin(): entity type name can't be empty\n");
-    return;
+    return ENTITY_TYPE_NONE;
   }
-  if (hash_table_get(entity_system.entities, &name)) {
+  atom type_name = atom_intern(name);
+  if (hash_table_get(entity_system.entities, &type_name)) {
     wrn("entity_type_begin(): entity type '%.*s' already exists\n", name.size, name.buff);
-    return;
+    return ENTITY_TYPE_NONE;
+  }
+  u32 slot = 0;
+  while (slot < array_list_size(entity_system.types) && entity_system.types[slot].name) slot++;
+  if (slot == ENTITY_TYPE_SLOTS) {
+    wrn("entity_type_begin(): there can't be more than %u entity types\n", ENTITY_TYPE_SLOTS);
+    return ENTITY_TYPE_NONE;
+  }
+  if (slot == array_list_size(entity_system.types)) {
+    entity_system.types = array_list_grow(entity_system.types, 1);
+    entity_system.types[slot].generation = 0;
   }
-  entity_system.new_type = hash_table_add(entity_system.entities, &name);
-  entity_system.new_type->component_names = array_list_create(sizeof (str));
-  entity_system.new_type->components      = hash_table_create(sizeof (entity_component), HT_STR);
-  entity_system.new_type->indexes_ids     = array_list_create(sizeof (u128));
-  entity_system.new_type->indexes         = hash_table_create(sizeof (u32), HT_U128);
-  entity_system.new_type->name_index      = array_list_size(entity_system.entity_type_names);
-  entity_system.new_type->amount          = 0;
-  array_list_push(entity_system.entity_type_names, string_create(name));
+  entity_type_id id = ENTITY_TYPE_ID(slot, entity_system.types[slot].generation);
+  *(entity_type_id *)hash_table_add(entity_system.entities, &type_name) = id;
+  const blib_allocator *allocator = blib_get_allocator();
+  entity_system.new_type = &entity_system.types[slot];
+  entity_system.new_type->components    = array_list_create_tagged(sizeof (entity_component), allocator, MEMORY_TAG_ENTITY_SYSTEM);
+  entity_system.new_type->component_ids = hash_table_create_tagged(sizeof (component_id), HT_U32,
+      allocator, MEMORY_TAG_ENTITY_SYSTEM);
+  entity_system.new_type->indexes_ids   = array_list_create_tagged(sizeof (u128), allocator, MEMORY_TAG_ENTITY_SYSTEM);
+  entity_system.new_type->indexes       = hash_table_create_tagged(sizeof (u32), HT_U128,
+      allocator, MEMORY_TAG_ENTITY_SYSTEM);
+  entity_system.new_type->amount        = 0;
+  entity_system.new_type->region        = memory.region;
+  entity_system.new_type->allocator     = allocator;
+  entity_system.new_type->name          = type_name;
+  return id;
 }
 
-void
+component_id
 entity_type_add_component(str name, u32 size) {
   if (!entity_system.new_type) {
     wrn("entity_type_add_component(): trying to create add component without initiating a new entity type. forgot entity_type_begin()?\n");
-    return;
+    return COMPONENT_NONE;
   }
   if (!name.size) {
     wrn("entity_type_add_component(): entity component name can't be empty\n");
-    return;
+    return COMPONENT_NONE;
   }
-  if (hash_table_get(entity_system.new_type->components, &name)) {
-    str entity_type_name;
-    hash_table_value_key(entity_system.entities, entity_system.new_type, &entity_type_name);
+  entity_type *type = entity_system.new_type;
+  atom comp_name = atom_intern(name);
+  if (hash_table_get(type->component_ids, &comp_name)) {
+    str entity_type_name = atom_str(type->name);
     wrn("entity_type_add_component(): component '%.*s' already exists on entity '%.*s'\n",
         name.size, name.buff, entity_type_name.size, entity_type_name.buff);
-    return;
+    return COMPONENT_NONE;
   }
-  entity_component *component = hash_table_add(entity_system.new_type->components, &name);
-  component->list = array_list_create(size);
-  component->type = size;
-  array_list_push(entity_system.new_type->component_names, string_create(name));
+  component_id id = array_list_size(type->components);
+  entity_component component;
+  component.list = array_list_create_tagged(size, type->allocator, MEMORY_TAG_ENTITY_SYSTEM);
+  component.type = size;
+  component.name = comp_name;
+  array_list_push(type->components, component);
+  *(component_id *)hash_table_add(type->component_ids, &comp_name) = id;
+  return id;
 }
 
 void
@@ -785,31 +3223,78 @@ entity_type_end(void) {
   entity_system.new_type = 0;
 }
 
+entity_type_id
+entity_type_find(str name) {
+  atom type_name = atom_find(name);
+  entity_type_id *id = hash_table_get(entity_system.entities, &type_name);
+  return id ? *id : ENTITY_TYPE_NONE;
+}
+
+component_id
+entity_type_find_component(entity_type_id type_id, str name) {
+  entity_type *type = entity_type_get(type_id);
+  if (!type) {
+    wrn("entity_type_find_component(): invalid type id '%u'\n", type_id);
+    return COMPONENT_NONE;
+  }
+  atom comp_name = atom_find(name);
+  component_id *id = hash_table_get(type->component_ids, &comp_name);
+  return id ? *id : COMPONENT_NONE;
+}
+
+void *
+entity_type_get_components_id(entity_type_id type_id, component_id comp) {
+  entity_type *type = entity_type_get(type_id);
+  if (!type) {
+    wrn("entity_type_get_components_id(): invalid type id '%u'\n", type_id);
+    return 0;
+  }
+  if (comp >= array_list_size(type->components)) {
+    wrn("entity_type_get_components_id(): unexisting component id '%u'\n", comp);
+    return 0;
+  }
+  return type->components[comp].list;
+}
+
+void *
+entity_type_get_components_atom(atom type_name, atom comp_name) {
+  entity_type *type = entity_type_get_atom(type_name);
+  if (!type) {
+    wrn("entity_type_get_components_atom(): invalid type '%.*s'\n", atom_str(type_name).size, atom_str(type_name).buff);
+    return 0;
+  }
+  entity_component *component = entity_type_component_atom(type, comp_name);
+  if (!component) {
+    wrn("entity_type_get_components_atom(): unexisting component '%.*s'\n", atom_str(comp_name).size, atom_str(comp_name).buff);
+    return 0;
+  }
+  return component->list;
+}
+
 void *
 entity_type_get_components(str type_name, str comp_name) {
-  entity_type *type = hash_table_get(entity_system.entities, &type_name);
+  atom type = atom_find(type_name);
   if (!type) {
     wrn("entity_type_get_components(): invalid type '%.*s'\n", type_name.size, type_name.buff);
     return 0;
   }
-  entity_component *component = hash_table_get(type->components, &comp_name);
-  if (!component) {
+  atom comp = atom_find(comp_name);
+  if (!comp) {
     wrn("entity_type_get_components(): unexisting component '%.*s'\n", comp_name.size, comp_name.buff);
     return 0;
   }
-  return (u8 *)component->list;
+  return entity_type_get_components_atom(type, comp);
 }
 
 void
 entity_type_clear(str name) {
-  entity_type *type = hash_table_get(entity_system.entities, &name);
+  entity_type *type = entity_type_get_atom(atom_find(name));
   if (!type) {
-    wrn("entity_type_get_components(): invalid type '%.*s'\n", name.size, name.buff);
+    wrn("entity_type_clear(): invalid type '%.*s'\n", name.size, name.buff);
     return;
   }
-  for (u32 i = 0; i < array_list_size(type->component_names); i++) {
-    entity_component *component = hash_table_get(type->components, &type->component_names[i]);
-    array_list_clear(component->list);
+  for (u32 i = 0; i < array_list_size(type->components); i++) {
+    array_list_clear(type->components[i].list);
   }
   array_list_clear(type->indexes_ids);
   hash_table_clear(type->indexes);
@@ -817,14 +3302,98 @@ entity_type_clear(str name) {
 }
 
 void
-entity_create(str type_name, entity *e) {
-  entity_type *type = hash_table_get(entity_system.entities, &type_name);
+entity_type_destroy(str name) {
+  atom type_name = atom_find(name);
+  entity_type *type = entity_type_get_atom(type_name);
   if (!type) {
-    wrn("entity_create(): type '%.*s' doesn't exists\n", type_name.size, type_name.buff);
+    wrn("entity_type_destroy(): invalid type '%.*s'\n", name.size, name.buff);
+    return;
+  }
+  if (entity_system.new_type == type) entity_system.new_type = 0;
+  for (u32 i = 0; i < array_list_size(type->components); i++) {
+    array_list_destroy(type->components[i].list);
+  }
+  array_list_destroy(type->components);
+  hash_table_destroy(type->component_ids);
+  array_list_destroy(type->indexes_ids);
+  hash_table_destroy(type->indexes);
+  type->name = ATOM_NONE;
+  type->generation = (type->generation + 1) & 0xffff;
+  hash_table_del(entity_system.entities, &type_name);
+}
+
+void
+entity_type_reserve(str name, u32 amount) {
+  entity_type *type = entity_type_get_atom(atom_find(name));
+  if (!type) {
+    wrn("entity_type_reserve(): invalid type '%.*s'\n", name.size, name.buff);
+    return;
+  }
+  /* array_list_grow() reallocates as soon as the size reaches the capacity */
+  if (array_list_capacity(type->indexes_ids) <= amount) {
+    type->indexes_ids = array_list_reserve(type->indexes_ids, amount + 1 - array_list_capacity(type->indexes_ids));
+  }
+  for (u32 i = 0; i < array_list_size(type->components); i++) {
+    entity_component *component = &type->components[i];
+    if (array_list_capacity(component->list) <= amount) {
+      component->list = array_list_reserve(component->list, amount + 1 - array_list_capacity(component->list));
+    }
+  }
+  hash_table_reserve(type->indexes, amount);
+}
+
+void
+entity_type_sort(str type_name, str comp_name, u32 key_offset, sort_key_type key, sort_flags flags) {
+  entity_type *type = entity_type_get_atom(atom_find(type_name));
+  if (!type) {
+    wrn("entity_type_sort(): invalid type '%.*s'\n", type_name.size, type_name.buff);
+    return;
+  }
+  entity_component *component = entity_type_component_atom(type, atom_find(comp_name));
+  if (!component) {
+    wrn("entity_type_sort(): unexisting component '%.*s'\n", comp_name.size, comp_name.buff);
+    return;
+  }
+  if (key_offset + (key == SORT_KEY_U64 ? sizeof (u64) : sizeof (u32)) > component->type) {
+    wrn("entity_type_sort(): key out of component '%.*s'\n", comp_name.size, comp_name.buff);
+    return;
+  }
+  u32 amount = array_list_size(type->indexes_ids);
+  if (amount < 2) return;
+  const blib_allocator *allocator = memory_base_allocator(); /* the scratch memory, not from the open region */
+  u32 *order = sort_radix_order(component->list, amount, component->type, key_offset, key, flags, allocator);
+
+  u32 max_type = sizeof (u128);
+  for (u32 i = 0; i < array_list_size(type->components); i++) {
+    max_type = MAX(max_type, type->components[i].type);
+  }
+  u8 *scratch = memory_alloc(allocator, MEMORY_TAG_ENTITY_SYSTEM, (u64)amount * max_type, BLIB_ALIGN);
+  for (u32 i = 0; i < array_list_size(type->components); i++) {
+    entity_component *c = &type->components[i];
+    sort_permute(c->list, amount, c->type, order, scratch);
+  }
+  sort_permute(type->indexes_ids, amount, sizeof (u128), order, scratch);
+  memory_free(allocator, MEMORY_TAG_ENTITY_SYSTEM, scratch, (u64)amount * max_type);
+  memory_free(allocator, MEMORY_TAG_OTHER, order, SORT_ORDER_BYTES(amount));
+
+  void *indexes[HASH_TABLE_BATCH];
+  for (u32 i = 0; i < amount; i += HASH_TABLE_BATCH) {
+    u32 count = MIN(HASH_TABLE_BATCH, amount - i);
+    hash_table_get_batch(type->indexes, &type->indexes_ids[i], count, indexes);
+    for (u32 j = 0; j < count; j++) *(u32 *)indexes[j] = i + j;
+  }
+}
+
+void
+entity_create_id(entity_type_id type_id, entity *e) {
+  entity_type *type = entity_type_get(type_id);
+  if (!type) {
+    wrn("entity_create_id(): type id '%u' doesn't exists\n", type_id);
     return;
   }
 
-  e->type = type->name_index;
+  e->type    = type->name;
+  e->type_id = type_id;
 
 #ifdef __linux
   uuid_generate((u8 *)&e->id);
@@ -832,79 +3401,156 @@ entity_create(str type_name, entity *e) {
 
   u32 *index = hash_table_add(type->indexes, &e->id);
   if (!index) {
-    err("entity_create(): unreachable\n");
+    err("entity_create_id(): unreachable\n");
     return;
   }
   *index = type->amount++;
-  for (u32 i = 0; i < array_list_size(type->component_names); i++) {
-    entity_component *component = hash_table_get(type->components, &type->component_names[i]);
+  for (u32 i = 0; i < array_list_size(type->components); i++) {
+    entity_component *component = &type->components[i];
     component->list = array_list_grow(component->list, 1);
   }
   array_list_push(type->indexes_ids, e->id);
 }
 
+void
+entity_create_atom(atom type_name, entity *e) {
+  entity_type_id *id = hash_table_get(entity_system.entities, &type_name);
+  if (!id) {
+    wrn("entity_create_atom(): type '%.*s' doesn't exists\n", atom_str(type_name).size, atom_str(type_name).buff);
+    return;
+  }
+  entity_create_id(*id, e);
+}
+
+void
+entity_create(str type_name, entity *e) {
+  atom type = atom_find(type_name);
+  if (!type) {
+    wrn("entity_create(): type '%.*s' doesn't exists\n", type_name.size, type_name.buff);
+    return;
+  }
+  entity_create_atom(type, e);
+}
+
+/* Returns the address of the component of `e` in the column `component`,
+ * `caller` names the function asking on the warnings. */
+static inline void *
+entity_component_of(entity_type *type, entity_component *component, entity *e, ccstr caller) {
+  u32 *index = hash_table_get(type->indexes, &e->id);
+  if (!index) {
+    wrn("%s(): entity doesn't exists\n", caller);
+    return 0;
+  }
+  return (u8 *)component->list + (*index) * component->type;
+}
+
 void *
-entity_get_component(entity *e, str comp_name) {
-  entity_type *type = hash_table_get(entity_system.entities, &entity_system.entity_type_names[e->type]);
+entity_get_component_id(entity *e, component_id comp) {
+  entity_type *type = entity_type_get(e->type_id);
+  if (!type) {
+    wrn("entity_get_component_id(): entity with invalid type\n");
+    return 0;
+  }
+  if (comp >= array_list_size(type->components)) {
+    wrn("entity_get_component_id(): unexisting component id '%u'\n", comp);
+    return 0;
+  }
+  return entity_component_of(type, &type->components[comp], e, "entity_get_component_id");
+}
+
+void *
+entity_get_component_atom(entity *e, atom comp_name) {
+  entity_type *type = entity_type_get(e->type_id);
   if (!type) {
-    wrn("entity_get_component(): entity with invalid type\n");
+    wrn("entity_get_component_atom(): entity with invalid type\n");
     return 0;
   }
-  entity_component *component = hash_table_get(type->components, &comp_name);
+  entity_component *component = entity_type_component_atom(type, comp_name);
   if (!component) {
-    wrn("entity_get_component(): unexisting component '%.*s'\n", comp_name.size, comp_name.buff);
+    wrn("entity_get_component_atom(): unexisting component '%.*s'\n", atom_str(comp_name).size, atom_str(comp_name).buff);
     return 0;
   }
-  u32 *index = hash_table_get(type->indexes, &e->id);
-  if (!index) {
-    wrn("entity_get_component(): entity doesn't exists\n");
+  return entity_component_of(type, component, e, "entity_get_component_atom");
+}
+
+void *
+entity_get_component(entity *e, str comp_name) {
+  atom comp = atom_find(comp_name);
+  if (!comp) {
+    wrn("entity_get_component(): unexisting component '%.*s'\n", comp_name.size, comp_name.buff);
     return 0;
   }
-  return (u8 *)component->list + (*index) * component->type;
+  return entity_get_component_atom(e, comp);
+}
+
+/* Decrements the index of every entity starting on `from`, after removing the one before it. */
+static void
+entity_type_shift_indexes(entity_type *type, u32 from) {
+  void *indexes[HASH_TABLE_BATCH];
+  u32 size = array_list_size(type->indexes_ids);
+  for (u32 i = from; i < size; i += HASH_TABLE_BATCH) {
+    u32 count = MIN(HASH_TABLE_BATCH, size - i);
+    hash_table_get_batch(type->indexes, &type->indexes_ids[i], count, indexes);
+    for (u32 j = 0; j < count; j++) (*(u32 *)indexes[j])--;
+  }
 }
 
 void
-entity_destroy_by_index(str type_name, u32 index) {
-  entity_type *type = hash_table_get(entity_system.entities, &type_name);
+entity_destroy_by_index_id(entity_type_id type_id, u32 index) {
+  entity_type *type = entity_type_get(type_id);
   if (!type) {
-    wrn("entity_destroy(): entity with invalid type\n");
+    wrn("entity_destroy_by_index_id(): entity with invalid type\n");
     return;
   }
   if (index >= array_list_size(type->indexes_ids)) {
-    wrn("entity_get_component(): entity with index '%u' doesn't exists\n", index);
+    wrn("entity_destroy_by_index_id(): entity with index '%u' doesn't exists\n", index);
     return;
   }
-  for (u32 i = index + 1; i < array_list_size(type->indexes_ids); i++) {
-    (*(u32 *)hash_table_get(type->indexes, &type->indexes_ids[i]))--;
-  }
-  for (u32 i = 0; i < array_list_size(type->component_names); i++) {
-    entity_component *component = hash_table_get(type->components, &type->component_names[i]);
-    array_list_remove(component->list, index, 0);
+  entity_type_shift_indexes(type, index + 1);
+  for (u32 i = 0; i < array_list_size(type->components); i++) {
+    array_list_remove(type->components[i].list, index, 0);
   }
   hash_table_del(type->indexes, &type->indexes_ids[index]);
   array_list_remove(type->indexes_ids, index, 0);
   type->amount--;
 }
 
+void
+entity_destroy_by_index_atom(atom type_name, u32 index) {
+  entity_type_id *id = hash_table_get(entity_system.entities, &type_name);
+  if (!id) {
+    wrn("entity_destroy_by_index_atom(): entity with invalid type\n");
+    return;
+  }
+  entity_destroy_by_index_id(*id, index);
+}
+
+void
+entity_destroy_by_index(str type_name, u32 index) {
+  atom type = atom_find(type_name);
+  if (!type) {
+    wrn("entity_destroy_by_index(): entity with invalid type\n");
+    return;
+  }
+  entity_destroy_by_index_atom(type, index);
+}
+
 void
 entity_destroy(entity *e) {
-  entity_type *type = hash_table_get(entity_system.entities, &entity_system.entity_type_names[e->type]);
+  entity_type *type = entity_type_get(e->type_id);
   if (!type) {
     wrn("entity_destroy(): entity with invalid type\n");
     return;
   }
   u32 *index = hash_table_get(type->indexes, &e->id);
   if (!index) {
-    wrn("entity_get_component(): entity doesn't exists\n");
+    wrn("entity_destroy(): entity doesn't exists\n");
     return;
   }
-  for (u32 i = (*index) + 1; i < array_list_size(type->indexes_ids); i++) {
-    (*(u32 *)hash_table_get(type->indexes, &type->indexes_ids[i]))--;
-  }
+  entity_type_shift_indexes(type, *index + 1);
   array_list_remove(type->indexes_ids, *index, 0);
-  for (u32 i = 0; i < array_list_size(type->component_names); i++) {
-    entity_component *component = hash_table_get(type->components, &type->component_names[i]);
-    array_list_remove(component->list, *index, 0);
+  for (u32 i = 0; i < array_list_size(type->components); i++) {
+    array_list_remove(type->components[i].list, *index, 0);
   }
   hash_table_del(type->indexes, &e->id);
   type->amount--;
@@ -941,12 +3587,17 @@ typedef struct {
   v2f char_padding;
   v2f char_size;
   v2f char_size_px;
+  /* glyphs are kept as the texture coordinates of their corner, ready to draw */
+  u32 columns;        /* glyphs on every row of the texture */
+  v2f ascii[128];     /* the glyph of every ASCII char */
+  v2f unknown;        /* the glyph of the codepoints that aren't mapped */
+  hash_table *glyphs; /* the glyphs of the codepoints past ASCII, NULL until some is mapped */
 } sprite_font;
 
 static struct {
-  hash_table *shaders;
-  hash_table *atlases;
-  hash_table *sprite_fonts;
+  hash_table *shaders;      /* keyed by the atoms of their names */
+  hash_table *atlases;      /* same */
+  hash_table *sprite_fonts; /* same */
   str path;
 } asset_manager;
 
@@ -990,9 +3641,10 @@ typedef struct {
 
 static void
 asset_manager_init(void) {
-  asset_manager.shaders      = hash_table_create(sizeof (shader_data),   HT_STR);
-  asset_manager.atlases      = hash_table_create(sizeof (texture_atlas), HT_STR);
-  asset_manager.sprite_fonts = hash_table_create(sizeof (sprite_font),   HT_STR);
+  const blib_allocator *allocator = memory_base_allocator();
+  asset_manager.shaders      = hash_table_create_tagged(sizeof (shader_data),   HT_U32, allocator, MEMORY_TAG_ASSETS);
+  asset_manager.atlases      = hash_table_create_tagged(sizeof (texture_atlas), HT_U32, allocator, MEMORY_TAG_ASSETS);
+  asset_manager.sprite_fonts = hash_table_create_tagged(sizeof (sprite_font),   HT_U32, allocator, MEMORY_TAG_ASSETS);
   asset_manager.path         = string_create(STR_0);
   string_reserve(&asset_manager.path, 1024);
 }
@@ -1015,7 +3667,7 @@ asset_manager_shader_create(str name, str path, GLenum type) {
   }
   fseek(sh_file, 0, SEEK_END);
   u32 sh_siz = ftell(sh_file);
-  cstr sh_src = malloc(sh_siz + 1);
+  cstr sh_src = memory_alloc(memory_base_allocator(), MEMORY_TAG_ASSETS, sh_siz + 1, 1);
   fseek(sh_file, 0, SEEK_SET);
   fread(sh_src, 1, sh_siz, sh_file);
   sh_src[sh_siz] = '\0';
@@ -1023,6 +3675,7 @@ asset_manager_shader_create(str name, str path, GLenum type) {
   result.sh = glCreateShader(type);
   glShaderSource(result.sh, 1, (ccstr *)&sh_src, 0);
   glCompileShader(result.sh);
+  memory_free(memory_base_allocator(), MEMORY_TAG_ASSETS, sh_src, sh_siz + 1);
 
   s32 status;
   glGetShaderiv(result.sh, GL_COMPILE_STATUS, &status);
@@ -1068,12 +3721,34 @@ asset_manager_image_create(str dir, str name) {
   return result;
 }
 
+/* Returns the texture coordinates of the glyph `index` of `font`. */
+static v2f
+sprite_font_glyph(sprite_font *font, u32 index) {
+  return V2F(
+    (index % font->columns) * font->char_size.x + font->char_sprite_padding.x,
+    (index / font->columns) * font->char_size.y
+  );
+}
+
+/* Lays out `font` as a grid of `char_size_px` glyphs after `padding_x` pixels and
+ * maps '!' to '~' to its first glyphs, like the single row sprite fonts. */
+static void
+sprite_font_layout(sprite_font *font, u32 padding_x) {
+  font->columns = MAX((font->width - MIN(padding_x, font->width)) / (u32)font->char_size_px.x, 1);
+  font->unknown = sprite_font_glyph(font, '~' + 1 - '!');
+  for (u32 c = 0; c < 128; c++) {
+    font->ascii[c] = c >= '!' && c <= '~' ? sprite_font_glyph(font, c - '!') : font->unknown;
+  }
+  if (font->glyphs) hash_table_clear(font->glyphs);
+}
+
 void
 asset_load(asset_type type, str name) {
+  atom asset_name = atom_intern(name);
   switch (type) {
     case ASSET_SHADER:
     {
-      shader_data *shader = hash_table_add(asset_manager.shaders, &name);
+      shader_data *shader = hash_table_add(asset_manager.shaders, &asset_name);
       if (!shader) {
         err("asset_load(): shader with the name '%.*s' is already loaded.\n", name.size, name.buff);
         exit(1);
@@ -1135,7 +3810,7 @@ asset_load(asset_type type, str name) {
     } break;
     case ASSET_ATLAS:
     {
-      texture_atlas *atlas = hash_table_add(asset_manager.atlases, &name);
+      texture_atlas *atlas = hash_table_add(asset_manager.atlases, &asset_name);
       if (!atlas) {
         err("asset_load(): texture atlas with the name '%.*s' is already loaded.\n", name.size, name.buff);
         exit(1);
@@ -1160,7 +3835,7 @@ asset_load(asset_type type, str name) {
     } break;
     case ASSET_SPRITE_FONT:
     {
-      sprite_font *font = hash_table_add(asset_manager.sprite_fonts, &name);
+      sprite_font *font = hash_table_add(asset_manager.sprite_fonts, &asset_name);
       if (!font) {
         err("asset_load(): sprite font with the name '%.*s' is already loaded.\n", name.size, name.buff);
         exit(1);
@@ -1183,42 +3858,46 @@ asset_load(asset_type type, str name) {
       font->char_size           = v2f_mul(font->pixel_size, font->char_size_px);
       font->char_padding        = V2F(0, 0);
       font->char_sprite_padding = V2F(0, 0);
+      font->glyphs              = 0;
+      sprite_font_layout(font, 0);
     } break;
   }
 }
 
 void
 asset_unload(asset_type type, str name) {
+  atom asset_name = atom_find(name);
   switch (type) {
     case ASSET_SHADER:
     {
-      shader_data *shader = hash_table_get(asset_manager.shaders, &name);
+      shader_data *shader = hash_table_get(asset_manager.shaders, &asset_name);
       if (!shader) {
         wrn("asset_unload(): already unloaded shader '%.*s'.\n", name.size, name.buff);
         return;
       }
       glDeleteProgram(shader->id);
-      hash_table_del(asset_manager.shaders, &name);
+      hash_table_del(asset_manager.shaders, &asset_name);
     } break;
     case ASSET_ATLAS:
     {
-      texture_atlas *tex = hash_table_get(asset_manager.atlases, &name);
+      texture_atlas *tex = hash_table_get(asset_manager.atlases, &asset_name);
       if (!tex) {
         wrn("asset_unload(): already unloaded atlas '%.*s'.\n", name.size, name.buff);
         return;
       }
       glDeleteTextures(1, &tex->id);
-      hash_table_del(asset_manager.atlases, &name);
+      hash_table_del(asset_manager.atlases, &asset_name);
     } break;
     case ASSET_SPRITE_FONT:
     {
-      sprite_font *font = hash_table_get(asset_manager.sprite_fonts, &name);
+      sprite_font *font = hash_table_get(asset_manager.sprite_fonts, &asset_name);
       if (!font) {
         wrn("asset_unload(): already unloaded sprite font '%.*s'.\n", name.size, name.buff);
         return;
       }
       glDeleteTextures(1, &font->id);
-      hash_table_del(asset_manager.sprite_fonts, &name);
+      if (font->glyphs) hash_table_destroy(font->glyphs);
+      hash_table_del(asset_manager.sprite_fonts, &asset_name);
     } break;
   }
 }
@@ -1227,8 +3906,10 @@ asset_unload(asset_type type, str name) {
  * *** Shader ***
  * */
 
-#define SHADER_GET(FUNC, SHADER, NAME) do { \
-  (SHADER) = hash_table_get(asset_manager.shaders, &(NAME));\
+#define SHADER_GET(FUNC, SHADER, NAME) SHADER_GET_ATOM(FUNC, SHADER, atom_find(NAME), NAME)
+#define SHADER_GET_ATOM(FUNC, SHADER, ATOM, NAME) do { \
+  atom shader_name_atom = (ATOM);\
+  (SHADER) = hash_table_get(asset_manager.shaders, &shader_name_atom);\
   if (!(SHADER)) {\
     err("%s(): shader '%.*s' isn't loaded.\n", #FUNC, (NAME).size, (NAME).buff);\
     exit(1);\
@@ -1412,8 +4093,10 @@ shader_set_uniform_m4_array(uniform uniform, m4 *values, u32 amount) {
  * *** Texture Atlas ***
  */
 
-#define ATLAS_GET(FUNC, ATLAS, NAME) do { \
-  (ATLAS) = hash_table_get(asset_manager.atlases, &(NAME));\
+#define ATLAS_GET(FUNC, ATLAS, NAME) ATLAS_GET_ATOM(FUNC, ATLAS, atom_find(NAME), NAME)
+#define ATLAS_GET_ATOM(FUNC, ATLAS, ATOM, NAME) do { \
+  atom atlas_name_atom = (ATOM);\
+  (ATLAS) = hash_table_get(asset_manager.atlases, &atlas_name_atom);\
   if (!(ATLAS)) {\
     err("%s(): atlas '%.*s' isn't loaded.\n", #FUNC, (NAME).size, (NAME).buff);\
     exit(1);\
@@ -1441,8 +4124,10 @@ texture_atlas_get_id(str name) {
  * Sprite Font
  */
 
-#define SPRITE_FONT_GET(FUNC, SPRITE_FONT, NAME) do { \
-  (SPRITE_FONT) = hash_table_get(asset_manager.sprite_fonts, &(NAME));\
+#define SPRITE_FONT_GET(FUNC, SPRITE_FONT, NAME) SPRITE_FONT_GET_ATOM(FUNC, SPRITE_FONT, atom_find(NAME), NAME)
+#define SPRITE_FONT_GET_ATOM(FUNC, SPRITE_FONT, ATOM, NAME) do { \
+  atom sprite_font_name_atom = (ATOM);\
+  (SPRITE_FONT) = hash_table_get(asset_manager.sprite_fonts, &sprite_font_name_atom);\
   if (!(SPRITE_FONT)) {\
     err("%s(): sprite font '%.*s' isn't loaded.\n", #FUNC, (NAME).size, (NAME).buff);\
     exit(1);\
@@ -1457,6 +4142,39 @@ sprite_font_setup(str name, u32 char_width, u32 char_height, u32 padding_x, u32
   font->char_size_px        = V2F(char_width, char_height);
   font->char_size           = v2f_mul(font->pixel_size, font->char_size_px);
   font->char_sprite_padding = v2f_mul(font->pixel_size, V2F(padding_x, padding_y));
+  sprite_font_layout(font, padding_x);
+}
+
+void
+sprite_font_map(str name, u32 first, u32 amount, u32 glyph) {
+  sprite_font *font;
+  SPRITE_FONT_GET(sprite_font_map, font, name);
+
+  for (u32 i = 0; i < amount; i++) {
+    u32 codepoint = first + i;
+    if (codepoint < 128) {
+      font->ascii[codepoint] = sprite_font_glyph(font, glyph + i);
+      continue;
+    }
+    if (!font->glyphs) {
+      font->glyphs = hash_table_create_tagged(sizeof (v2f), HT_U32, memory_base_allocator(), MEMORY_TAG_ASSETS);
+    }
+    v2f *mapped = hash_table_get(font->glyphs, &codepoint);
+    if (!mapped) mapped = hash_table_add(font->glyphs, &codepoint);
+    *mapped = sprite_font_glyph(font, glyph + i);
+  }
+}
+
+void
+sprite_font_map_unknown(str name, u32 glyph) {
+  sprite_font *font;
+  SPRITE_FONT_GET(sprite_font_map_unknown, font, name);
+
+  v2f unknown = sprite_font_glyph(font, glyph);
+  for (u32 c = 0; c < 128; c++) {
+    if (font->ascii[c].x == font->unknown.x && font->ascii[c].y == font->unknown.y) font->ascii[c] = unknown;
+  }
+  font->unknown = unknown;
 }
 
 texture_id
@@ -1471,6 +4189,7 @@ sprite_font_get_id(str name) {
  */
 
 typedef struct {
+  const blib_allocator *allocator; /* the one it was created with */
   texture_id id;
   u32 width;
   u32 height;
@@ -1478,10 +4197,18 @@ typedef struct {
 
 #define TEXTURE_BUFF_HEADER(BUFF) (((texture_buff_header *)BUFF) - 1)
 
+/* The pixels start this far into the allocation, the header is right before them. */
+#define TEXTURE_BUFF_PREFIX ALIGN_UP(sizeof (texture_buff_header), BLIB_ALIGN)
+#define TEXTURE_BUFF_BYTES(HEADER) (TEXTURE_BUFF_PREFIX + (u64)(HEADER)->width * (HEADER)->height * sizeof (pixel))
+
 pixel *
 texture_buff_create(u32 width, u32 height, texture_buff_attributes *attribs) {
-  texture_buff_header *header = malloc(sizeof (texture_buff_header) + (width * height * sizeof (pixel)));
-  pixel *buff = (pixel *)(header + 1);
+  const blib_allocator *allocator = blib_get_allocator();
+  u8 *block = memory_alloc(allocator, MEMORY_TAG_TEXTURE_BUFFERS,
+      TEXTURE_BUFF_PREFIX + (u64)width * height * sizeof (pixel), BLIB_ALIGN);
+  pixel *buff = (pixel *)(block + TEXTURE_BUFF_PREFIX);
+  texture_buff_header *header = TEXTURE_BUFF_HEADER(buff);
+  header->allocator = allocator;
   header->width = width;
   header->height = height;
   glGenTextures(1, &header->id);
@@ -1516,7 +4243,8 @@ void
 texture_buff_destroy(pixel *buff) {
   texture_buff_header *header = TEXTURE_BUFF_HEADER(buff);
   glDeleteTextures(1, &header->id);
-  free(header);
+  memory_free(header->allocator, MEMORY_TAG_TEXTURE_BUFFERS,
+      (u8 *)buff - TEXTURE_BUFF_PREFIX, TEXTURE_BUFF_BYTES(header));
 }
 
 /*
@@ -1576,11 +4304,21 @@ camera_get_angle(void) {
  * *** Rendering ***
  */
 
+/* Returns the atom of a name of the batch. The game can change the name any
+ * time, but it's only hashed again when it isn't the one of `*cache` anymore. */
+static inline atom
+batch_name_atom(atom *cache, str name) {
+  if (!string_equal(atom_str(*cache), name)) *cache = atom_find(name);
+  return *cache;
+}
+
 static void
 renderer_init(void) {
   renderer.quads_amount = 0;
-  renderer.quads_vertices = malloc(sizeof (vertex) * renderer.quads_vertices_capa);
-  u32 *indices = malloc(sizeof (u32) * renderer.quads_indices_capa);
+  const blib_allocator *allocator = memory_base_allocator();
+  renderer.quads_vertices = memory_alloc(allocator, MEMORY_TAG_RENDERER,
+      sizeof (vertex) * renderer.quads_vertices_capa, BLIB_ALIGN);
+  u32 *indices = memory_alloc(allocator, MEMORY_TAG_RENDERER, sizeof (u32) * renderer.quads_indices_capa, BLIB_ALIGN);
 
   u32 j = 0;
   for (u32 i = 0; i < renderer.quads_indices_capa; i += 6) {
@@ -1614,16 +4352,21 @@ renderer_init(void) {
   glEnableVertexAttribArray(2);
   glVertexAttribPointer(2, 4, GL_FLOAT, GL_FALSE, sizeof (vertex), (void *)offsetof(vertex, blend));
 
-  free(indices);
+  memory_free(allocator, MEMORY_TAG_RENDERER, indices, sizeof (u32) * renderer.quads_indices_capa);
 
   glEnable(GL_BLEND);
   glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
-  renderer.quads_requests = malloc(sizeof (quad **) * renderer.layers_amount);
+  renderer.quads_requests = memory_alloc(allocator, MEMORY_TAG_RENDERER,
+      sizeof (quad **) * renderer.layers_amount, BLIB_ALIGN);
+  renderer.layers_sort_by_y = memory_alloc(allocator, MEMORY_TAG_RENDERER,
+      sizeof (b8) * renderer.layers_amount, BLIB_ALIGN);
+  memset(renderer.layers_sort_by_y, 0, sizeof (b8) * renderer.layers_amount);
   for (u32 i = 0; i < renderer.layers_amount; i++) {
-    renderer.quads_requests[i] = malloc(sizeof (quad *) * BATCH_SHADERS_AMOUNT);
+    renderer.quads_requests[i] = memory_alloc(allocator, MEMORY_TAG_RENDERER,
+        sizeof (quad *) * BATCH_SHADERS_AMOUNT, BLIB_ALIGN);
     for (u32 j = 0; j < BATCH_SHADERS_AMOUNT; j++) {
-      renderer.quads_requests[i][j] = array_list_create(sizeof (quad));
+      renderer.quads_requests[i][j] = array_list_create_tagged(sizeof (quad), allocator, MEMORY_TAG_RENDERER);
     }
   }
 
@@ -1650,14 +4393,14 @@ submit_batch(void) {
   texture_id atlas_id = 0;
   if (renderer.batch.atlas.size > 0) {
     texture_atlas *atlas;
-    ATLAS_GET(submit_batch, atlas, renderer.batch.atlas);
+    ATLAS_GET_ATOM(submit_batch, atlas, batch_name_atom(&renderer.batch_atlas, renderer.batch.atlas), renderer.batch.atlas);
     atlas_id = atlas->id;
   }
 
   texture_id font_id;
   if (renderer.batch.font.size > 0) {
     sprite_font *font;
-    SPRITE_FONT_GET(submit_batch, font, renderer.batch.font);
+    SPRITE_FONT_GET_ATOM(submit_batch, font, batch_name_atom(&renderer.batch_font, renderer.batch.font), renderer.batch.font);
     font_id = font->id;
   } else {
     err("submit_batch(): A batch font needs to be set.\n");
@@ -1706,7 +4449,8 @@ submit_batch(void) {
       u32 vertices_amount = 0;
       u32 indices_amount  = 0;
       shader_data *shader;
-      SHADER_GET(submit_batch, shader, renderer.batch.shaders[k]);
+      SHADER_GET_ATOM(submit_batch, shader, batch_name_atom(&renderer.batch_shaders[k], renderer.batch.shaders[k]),
+          renderer.batch.shaders[k]);
       glUseProgram(shader->id);
       if (shader->use_camera_projection) {
         shader_set_uniform_m3(shader->u_camera, camera_matrix);
@@ -1719,6 +4463,10 @@ submit_batch(void) {
         case BATCH_SHADER_LINE:                                               break;
         case BATCH_SHADERS_AMOUNT:                                            break;
       };
+      if (renderer.layers_sort_by_y[i]) {
+        sort_radix_with(renderer.quads_requests[i][k], array_list_size(renderer.quads_requests[i][k]), sizeof (quad),
+            offsetof(vertex, position) + offsetof(v2f, y), SORT_KEY_F32, SORT_DESCENDING, frame_allocator());
+      }
       for (u32 j = 0; j < array_list_size(renderer.quads_requests[i][k]); j++) {
         renderer.quads_vertices[vertices_amount++] = (vertex) {
           .position = renderer.quads_requests[i][k][j][0].position,
@@ -1751,6 +4499,15 @@ submit_batch(void) {
   renderer.quads_amount = 0;
 }
 
+void
+layer_sort_by_y(u32 layer, b8 enable) {
+  if (layer >= renderer.layers_amount) {
+    wrn("layer_sort_by_y(): out of bounds layer: %u.\n", layer);
+    return;
+  }
+  renderer.layers_sort_by_y[layer] = enable;
+}
+
 void
 clear_screen(v4f color) {
   glClear(GL_COLOR_BUFFER_BIT);
@@ -1838,7 +4595,7 @@ draw_tile(v2u tile, v2f position, v2f scale, v2f pivot, f32 angle, v4f blend, u3
   }
 
   texture_atlas *atlas;
-  ATLAS_GET(draw_tile, atlas, renderer.batch.atlas);
+  ATLAS_GET_ATOM(draw_tile, atlas, batch_name_atom(&renderer.batch_atlas, renderer.batch.atlas), renderer.batch.atlas);
 
   v2f tile_pos = v2f_add(
     v2f_mul(atlas->tile_size,    V2F(tile.x, tile.y)),
@@ -1856,8 +4613,6 @@ draw_tile(v2u tile, v2f position, v2f scale, v2f pivot, f32 angle, v4f blend, u3
       BATCH_SHADER_ATLAS, texcoord_bl, texcoord_br, texcoord_tr, texcoord_tl);
 }
 
-#define DRAW_TEXT_CAP 512
-#define UNK_CHAR ('~'+1)
 void
 draw_text(v2f position, v2f scale, v4f blend, u32 layer, str fmt, ...) {
   if (renderer.batch.font.size == 0) {
@@ -1866,23 +4621,36 @@ draw_text(v2f position, v2f scale, v4f blend, u32 layer, str fmt, ...) {
   }
 
   sprite_font *font;
-  SPRITE_FONT_GET(draw_text, font, renderer.batch.font);
+  SPRITE_FONT_GET_ATOM(draw_text, font, batch_name_atom(&renderer.batch_font, renderer.batch.font), renderer.batch.font);
 
   va_list args;
   va_start(args, fmt);
-  u8 chars[DRAW_TEXT_CAP];
-  vsnprintf((cstr)chars, DRAW_TEXT_CAP, fmt.buff, args);
+  str text = string_vformat_arena(frame_arena_get(), fmt, args);
   va_end(args);
+  const u8 *chars = (const u8 *)text.buff;
+
+  v2f char_siz = v2f_mul(scale, font->char_size_px);
+  v2f char_adv = v2f_add(char_siz, v2f_mul(scale, font->char_padding));
 
   v2f text_cursor = V2F_0;
-  for (u32 i = 0; i < DRAW_TEXT_CAP; i++) {
-    if (chars[i] == '\0') return;
+  for (u32 i = 0; i < text.size;) {
     if (renderer.quads_amount * 4 >= renderer.quads_vertices_capa) {
       submit_batch();
     }
 
-    u8 c = chars[i];
-    if ((c < ' ' || c > '~') && c != '\n') c = UNK_CHAR;
+    /* ASCII goes straight through its table, the rest is decoded and looked up */
+    u32 c = chars[i];
+    v2f char_font_pos;
+    if (c < 0x80) {
+      char_font_pos = font->ascii[c];
+      i++;
+    } else {
+      u32 next = i;
+      c = string_utf8_next(text, &next);
+      i = next;
+      v2f *mapped = font->glyphs ? hash_table_get(font->glyphs, &c) : 0;
+      char_font_pos = mapped ? *mapped : font->unknown;
+    }
     if (c == ' ') {
       text_cursor.x++;
       continue;
@@ -1892,10 +4660,7 @@ draw_text(v2f position, v2f scale, v4f blend, u32 layer, str fmt, ...) {
       text_cursor.x = 0;
       continue;
     }
-    v2f char_siz = v2f_mul(scale, font->char_size_px);
-    v2f char_font_pos = V2F((c - '!') * font->char_size.x + font->char_sprite_padding.x, 0);
-    v2f char_pad = v2f_mul(scale, font->char_padding);
-    v2f char_pos = v2f_add(position, v2f_mul(text_cursor, v2f_add(char_siz, char_pad)));
+    v2f char_pos = v2f_add(position, v2f_mul(text_cursor, char_adv));
 
     v2f texcoord_tl = v2f_add(char_font_pos, V2F(0,                 font->char_size.y));
     v2f texcoord_tr = v2f_add(char_font_pos, V2F(font->char_size.x, font->char_size.y));
@@ -1909,8 +4674,6 @@ draw_text(v2f position, v2f scale, v4f blend, u32 layer, str fmt, ...) {
   }
 
 }
-#undef DRAW_TEXT_CAP
-#undef UNK_CHAR
 
 void
 draw_texture_buff(v2f position, v2f size, v2f pivot, f32 angle, v4f blend, u32 layer, v2f *parts) {
@@ -2038,6 +4801,207 @@ mouse_get_scroll(void) {
   return input.mouse.scroll;
 }
 
+/*
+ * Input Recording
+ */
+
+static void
+args_parse(s32 argc, cstr *argv) {
+  for (s32 i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "--record") || !strcmp(argv[i], "--replay")) {
+      if (i + 1 >= argc) {
+        err("%s: missing file path\n", argv[i]);
+        exit(1);
+      }
+      if (input_record.mode != INPUT_RECORD_NONE) {
+        err("%s: only one of --record and --replay can be used\n", argv[i]);
+        exit(1);
+      }
+      input_record.mode = !strcmp(argv[i], "--record") ? INPUT_RECORD_WRITE : INPUT_RECORD_REPLAY;
+      input_record.path = argv[++i];
+    } else if (!strcmp(argv[i], "--fast")) {
+      input_record.fast = true;
+    } else if (!strcmp(argv[i], "--headless")) {
+      input_record.headless = true;
+    } else if (!strcmp(argv[i], "--frame-stats")) {
+      frame_stats.enabled = true;
+    } else if (!strcmp(argv[i], "--frames")) {
+      if (i + 1 >= argc) {
+        err("%s: missing frames amount\n", argv[i]);
+        exit(1);
+      }
+      frame_stats.frames_limit = strtoul(argv[++i], 0, 10);
+    } else {
+      wrn("unknown argument '%s'\n", argv[i]);
+    }
+  }
+  if ((input_record.fast || input_record.headless) && input_record.mode != INPUT_RECORD_REPLAY) {
+    wrn("--fast and --headless only have effect together with --replay\n");
+    input_record.fast     = false;
+    input_record.headless = false;
+  }
+}
+
+/* Opens the record file and sets up the rng seed. Must be called before anything uses `rand()`. */
+static void
+input_record_begin(void) {
+  input_record_header header;
+  input_record.seed = time(0);
+  switch (input_record.mode) {
+    case INPUT_RECORD_NONE: break;
+    case INPUT_RECORD_WRITE:
+      input_record.file = fopen(input_record.path, "wb");
+      if (!input_record.file) {
+        err("input_record_begin(): couldn't create '%s'\n", input_record.path);
+        exit(1);
+      }
+      header.magic   = INPUT_RECORD_MAGIC;
+      header.version = INPUT_RECORD_VERSION;
+      header.seed    = input_record.seed;
+      fwrite(&header, sizeof (header), 1, input_record.file);
+      break;
+    case INPUT_RECORD_REPLAY:
+      input_record.file = fopen(input_record.path, "rb");
+      if (!input_record.file) {
+        err("input_record_begin(): couldn't open '%s'\n", input_record.path);
+        exit(1);
+      }
+      if (fread(&header, sizeof (header), 1, input_record.file) != 1 ||
+          header.magic != INPUT_RECORD_MAGIC || header.version != INPUT_RECORD_VERSION) {
+        err("input_record_begin(): '%s' isn't a valid input record\n", input_record.path);
+        exit(1);
+      }
+      input_record.seed = header.seed;
+      break;
+  }
+  srand(input_record.seed);
+}
+
+/* The time left before a deadline that is spun instead of slept, sleeping
+ * can overshoot by a scheduler tick. */
+#define INPUT_RECORD_SPIN_TIME 0.0005
+
+/* Waits until `end` (in glfwGetTime() time), sleeping most of the way. */
+static void
+input_record_wait(f64 end) {
+  f64 left = end - glfwGetTime();
+  if (left > INPUT_RECORD_SPIN_TIME) {
+    left -= INPUT_RECORD_SPIN_TIME;
+    struct timespec ts = { .tv_sec = (time_t)left, .tv_nsec = (long)((left - (time_t)left) * 1e9) };
+    nanosleep(&ts, 0);
+  }
+  while (glfwGetTime() < end);
+}
+
+/* Records or replays the input state of the current frame.
+ * On replay `dt` is replaced by the recorded one.
+ * Returns false when the replay is over. */
+static b8
+input_record_next_frame(f32 *dt) {
+  input_record_frame frame;
+  switch (input_record.mode) {
+    case INPUT_RECORD_NONE: break;
+    case INPUT_RECORD_WRITE:
+      frame.dt              = *dt;
+      frame.screen_position = input.mouse.screen_position;
+      frame.scroll          = input.mouse.scroll;
+      memcpy(frame.keys_cur,    input.keyboard.keys_cur, sizeof (b8) * KEY_CAP);
+      memcpy(frame.buttons_cur, input.mouse.buttons_cur, sizeof (b8) * BTN_CAP);
+      fwrite(&frame, sizeof (frame), 1, input_record.file);
+      break;
+    case INPUT_RECORD_REPLAY:
+      if (fread(&frame, sizeof (frame), 1, input_record.file) != 1) return false;
+      if (!input_record.fast) {
+        /* pace the replay to the recorded frame times */
+        input_record_wait(glfwGetTime() + (frame.dt - *dt));
+      }
+      *dt                         = frame.dt;
+      input.mouse.screen_position = frame.screen_position;
+      input.mouse.scroll          = frame.scroll;
+      memcpy(input.keyboard.keys_cur, frame.keys_cur,    sizeof (b8) * KEY_CAP);
+      memcpy(input.mouse.buttons_cur, frame.buttons_cur, sizeof (b8) * BTN_CAP);
+      break;
+  }
+  input_record.frames++;
+  return true;
+}
+
+static void
+input_record_end(f64 elapsed) {
+  if (input_record.mode == INPUT_RECORD_NONE) return;
+  fclose(input_record.file);
+  if (input_record.mode == INPUT_RECORD_WRITE) {
+    inf("recorded %lu frames into '%s'\n", (unsigned long)input_record.frames, input_record.path);
+    return;
+  }
+  if (elapsed <= 0) elapsed = 1e-9;
+  inf("replayed %lu frames and %lu ticks in %.3fs: %.1f frames/s, %.1f ticks/s\n",
+      (unsigned long)input_record.frames, (unsigned long)input_record.ticks, elapsed,
+      input_record.frames / elapsed, input_record.ticks / elapsed);
+}
+
+/*
+ * *** Frame Stats ***
+ * */
+
+static void
+frame_stats_report(void) {
+  if (!frame_stats.enabled) return;
+  u32 amount = segment_list_size(frame_stats.times);
+  if (!amount) {
+    wrn("frame_stats_report(): no frames were measured\n");
+    return;
+  }
+  f32 *times = memory_alloc(memory_base_allocator(), MEMORY_TAG_OTHER, sizeof (f32) * amount, BLIB_ALIGN);
+  for (u32 i = 0, copied = 0; i < segment_list_segments(frame_stats.times); i++) {
+    u32 size;
+    f32 *segment = segment_list_segment(frame_stats.times, i, &size);
+    memcpy(times + copied, segment, sizeof (f32) * size);
+    copied += size;
+  }
+  sort_radix(times, amount, sizeof (f32), 0, SORT_KEY_F32, 0);
+  f64 total = 0;
+  for (u32 i = 0; i < amount; i++) total += times[i];
+#define PERCENTILE(P) (times[(u32)((amount - 1) * (P))] * 1000.0f)
+  inf("frame time of %u frames (ms): avg %.3f, p50 %.3f, p90 %.3f, p99 %.3f, p99.9 %.3f, max %.3f\n",
+      amount, total / amount * 1000.0, PERCENTILE(0.5), PERCENTILE(0.9), PERCENTILE(0.99),
+      PERCENTILE(0.999), PERCENTILE(1.0));
+#undef PERCENTILE
+  if (frame_arena.arenas[0]) {
+    inf("frame arena: peak %lu bytes in a frame, %lu bytes per arena (blib_config.frame_arena_size)\n",
+        (unsigned long)MAX(arena_peak(frame_arena.arenas[0]), arena_peak(frame_arena.arenas[1])),
+        (unsigned long)frame_arena.size);
+  }
+  memory_free(memory_base_allocator(), MEMORY_TAG_OTHER, times, sizeof (f32) * amount);
+  segment_list_destroy(frame_stats.times);
+}
+
+#ifdef BLIB_CONTAINER_STATS
+/* Dumps the statistics of the containers of the engine. */
+static void
+container_stats_report(void) {
+  char name[128];
+  hash_table_stats_dump(entity_system.entities, "entity types");
+  for (u32 i = 0; i < array_list_size(entity_system.types); i++) {
+    entity_type *type = &entity_system.types[i];
+    if (!type->name) continue;
+    str type_name = atom_str(type->name);
+    snprintf(name, sizeof (name), "%.*s indexes", type_name.size, type_name.buff);
+    hash_table_stats_dump(type->indexes, name);
+    for (u32 j = 0; j < array_list_size(type->components); j++) {
+      entity_component *component = &type->components[j];
+      str comp_name = atom_str(component->name);
+      snprintf(name, sizeof (name), "%.*s %.*s", type_name.size, type_name.buff,
+          comp_name.size, comp_name.buff);
+      array_list_stats_dump(component->list, name);
+    }
+  }
+  hash_table_stats_dump(asset_manager.shaders,      "shaders");
+  hash_table_stats_dump(asset_manager.atlases,      "atlases");
+  hash_table_stats_dump(asset_manager.sprite_fonts, "sprite fonts");
+}
+#endif
+
 /*
  * *** Window and Context things ***
  * */
@@ -2057,16 +5021,26 @@ extern void __quit(void);
 
 static void
 window_create(void) {
-  config.window_title       = "Blib App";
-  config.window_center      = true;
-  config.window_resizable   = false;
-  config.game_width         = 640;
-  config.game_height        = 480;
-  config.game_scale         = 1.0f;
-  config.quads_capacity     = 10000;
-  config.layers_amount      = 5;
-  config.ticks_per_second   = 60;
+  config.window_title         = "Blib App";
+  config.window_center        = true;
+  config.window_resizable     = false;
+  config.game_width           = 640;
+  config.game_height          = 480;
+  config.game_scale           = 1.0f;
+  config.quads_capacity       = 10000;
+  config.layers_amount        = 5;
+  config.ticks_per_second     = 60;
+  config.frame_stats          = false;
+  config.allocator            = 0;
+  config.frame_arena_size     = FRAME_ARENA_DEFAULT_SIZE;
+  config.memory_warmup_frames = MEMORY_WARMUP_DEFAULT_FRAMES;
   __conf(&config);
+  memory.allocator = config.allocator;
+  frame_arena.size = config.frame_arena_size;
+#ifdef BLIB_MEMORY_STATS
+  memory.warmup_frames = config.memory_warmup_frames;
+#endif
+  if (config.frame_stats) frame_stats.enabled = true;
   renderer.quads_vertices_capa = config.quads_capacity * 4;
   renderer.quads_indices_capa  = config.quads_capacity * 6;
   renderer.layers_amount       = config.layers_amount;
@@ -2087,6 +5061,7 @@ window_create(void) {
   glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
   glfwWindowHint(GLFW_RESIZABLE, config.window_resizable ? GLFW_TRUE : GLFW_FALSE);
   glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+  if (input_record.headless) glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
 #if macintosh || Macintosh || (__APPLE__ && __MACH__)
   glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, true);
 #endif
@@ -2129,12 +5104,14 @@ close_window(void) {
 
 void
 enable_vsync(b8 enable) {
+  if (input_record.fast) return; /* a fast replay never waits for the screen */
   glfwSwapInterval(enable);
 }
 
 s32
-main(void) {
-  srand(time(0));
+main(s32 argc, cstr *argv) {
+  args_parse(argc, argv);
+  input_record_begin();
 
   window_create();
 
@@ -2144,16 +5121,25 @@ main(void) {
   camera_init();
 
   __init();
+  if (input_record.fast) glfwSwapInterval(0);
+  if (frame_stats.enabled) frame_stats.times = segment_list_create(sizeof (f32), 0);
   f32 prev_time = glfwGetTime();
+  f64 start_time = prev_time;
   while (!glfwWindowShouldClose(window)) {
     f32 dt = glfwGetTime() - prev_time;
     prev_time = glfwGetTime();
+    if (frame_stats.enabled && frame_stats.frames > 0) segment_list_push(frame_stats.times, &dt);
+    if (frame_stats.frames_limit && frame_stats.frames >= frame_stats.frames_limit) break;
+    frame_stats.frames++;
+    if (!input_record_next_frame(&dt)) break;
+    memory_frame_begin();
     __loop(dt);
-    __draw(&renderer.batch);
+    if (!input_record.headless) __draw(&renderer.batch);
     tick_acc += dt;
     if (tick_acc >= ticks_per_second) {
       tick_acc = 0;
       __tick(dt);
+      input_record.ticks++;
       memcpy(input.keyboard.keys_tick_prv, input.keyboard.keys_cur, sizeof (b8) * KEY_CAP);
       memcpy(input.mouse.buttons_tick_prv, input.mouse.buttons_cur, sizeof (b8) * BTN_CAP);
     }
@@ -2166,9 +5152,19 @@ main(void) {
     input.mouse.position.x -= camera.width  * 0.5f;
     input.mouse.position.y = camera.height * 0.5f - input.mouse.position.y;
 
-    glfwSwapBuffers(window);
+    if (!input_record.headless) glfwSwapBuffers(window);
+    memory_frame_end();
+    frame_arena_swap();
     glfwPollEvents();
   }
+  input_record_end(glfwGetTime() - start_time);
+  frame_stats_report();
+#ifdef BLIB_MEMORY_STATS
+  memory_stats_dump();
+#endif
+#ifdef BLIB_CONTAINER_STATS
+  container_stats_report();
+#endif
   __quit();
 
   window_destroy();
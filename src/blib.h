@@ -2,9 +2,12 @@
 #define __BLIB_H__
 
 #include <math.h>
+#include <stdarg.h>
+#include <stddef.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 /*
  *
@@ -543,6 +546,172 @@ m4_mul_v4f(m4 a, v4f b) {
  * ****************************
  */
 
+/*
+ * *** Memory ***
+ * */
+
+/* The alignment of every container payload, a cache line. */
+#define BLIB_ALIGN 64
+
+/* Rounds `X` up to a multiple of `A`, which must be a power of two. */
+#define ALIGN_UP(X, A) (((X) + ((A) - 1)) & ~((u64)(A) - 1))
+
+/* Where blib gets its memory from. Every function gets the `ctx` of the allocator and
+ * `align`, a power of two the returned pointer must be aligned to. `resize` and `release`
+ * also get the size the memory was allocated with, so allocators need no headers. */
+typedef struct {
+  void *(*alloc)(void *ctx, u64 size, u32 align);
+  void *(*resize)(void *ctx, void *ptr, u64 old_size, u64 size, u32 align);
+  void  (*release)(void *ctx, void *ptr, u64 size);
+  void  *ctx;
+} blib_allocator;
+
+/* The malloc based allocator blib uses unless `blib_config.allocator` is set. */
+extern const blib_allocator blib_default_allocator;
+
+/* Returns the allocator of the library, the one containers use when none is given. */
+extern const blib_allocator *blib_get_allocator(void);
+
+/* The subsystems the allocations of blib are tagged with. */
+typedef enum {
+  MEMORY_TAG_OTHER = 0,
+  MEMORY_TAG_STRINGS,
+  MEMORY_TAG_ARRAY_LISTS, /* and segment lists */
+  MEMORY_TAG_HASH_TABLES,
+  MEMORY_TAG_ENTITY_SYSTEM,
+  MEMORY_TAG_RENDERER,
+  MEMORY_TAG_ASSETS,
+  MEMORY_TAG_TEXTURE_BUFFERS,
+  MEMORY_TAG_ARENAS,      /* the blocks of arenas, pools and regions */
+  MEMORY_TAGS_AMOUNT
+} memory_tag;
+
+/* Allocation statistics of a subsystem, only collected when blib is built with
+ * BLIB_MEMORY_STATS, otherwise they're all zero. Only what blib gets from its
+ * allocator is counted, memory handed out by arenas and pools is counted once,
+ * as the blocks they hold. Reallocations count as allocations. */
+typedef struct {
+  u64 live_bytes;
+  u64 peak_bytes;
+  u64 allocs;
+  u64 frees;
+  u64 frame_allocs; /* during the last frame */
+  u64 loop_allocs;  /* since the main loop started */
+  u64 hot_allocs;   /* between `__loop` and the buffer swap, after the warm-up frames */
+} memory_stats;
+
+/* Returns the allocation statistics of a subsystem. */
+extern memory_stats memory_get_stats(memory_tag tag);
+
+/* Returns the name of a subsystem, e.g. "strings". */
+extern ccstr memory_tag_name(memory_tag tag);
+
+/* Prints the allocation statistics of every subsystem. */
+extern void memory_stats_dump(void);
+
+/*
+ * *** Arena ***
+ * */
+
+/* A bump allocator, everything allocated from it is freed at once by `arena_reset`. */
+typedef struct arena arena;
+
+/* Creates an arena that starts with `capa` bytes. It grows when they run out and
+ * the next reset merges what it grew into a single block. */
+extern arena *arena_create(u64 capa);
+
+/* Allocates `size` bytes aligned to `align`, a power of two. */
+extern void  *arena_alloc(arena *arena, u64 size, u32 align);
+
+/* Frees everything allocated from the arena. */
+extern void   arena_reset(arena *arena);
+
+/* Returns the bytes allocated since the last reset. */
+extern u64    arena_used(arena *arena);
+
+/* Returns the most bytes the arena had allocated between two resets. */
+extern u64    arena_peak(arena *arena);
+
+/* Returns an allocator over the arena, to give containers to it,
+ * e.g. `array_list_create_with(sizeof (v2f), arena_allocator(arena))`. */
+extern const blib_allocator *arena_allocator(arena *arena);
+
+/* Destroys the arena. */
+extern void   arena_destroy(arena *arena);
+
+/* Allocates `size` bytes from the frame arena. They stay valid during this
+ * frame and the next one, the main loop frees them afterwards. */
+extern void  *frame_alloc(u64 size, u32 align);
+
+/* Returns an allocator over the frame arena, for temporary containers. */
+extern const blib_allocator *frame_allocator(void);
+
+/*
+ * *** Pool ***
+ * */
+
+/* An allocator of same sized items carved from slabs, freed items go to a free list.
+ * Built with BLIB_POOL_POISON freed items are filled with POOL_POISON_FREED and
+ * checked when allocated again, new items are filled with POOL_POISON_ALLOCATED. */
+typedef struct pool pool;
+
+#define POOL_POISON_FREED     0xdd
+#define POOL_POISON_ALLOCATED 0xcd
+
+/* Creates a pool of `item_size` items, `slab_items` items per slab (0 picks slabs of
+ * about 16 KiB). The item size is rounded up to a multiple of 16 bytes (8 if it's
+ * smaller) and items are aligned to the largest power of two dividing it, up to BLIB_ALIGN. */
+extern pool *pool_create(u32 item_size, u32 slab_items);
+
+/* Returns a free item. */
+extern void *pool_alloc(pool *pool);
+
+/* Gives `item` back to the pool. */
+extern void  pool_free(pool *pool, void *item);
+
+/* Frees every item at once, keeping the slabs for reuse. */
+extern void  pool_reset(pool *pool);
+
+/* Returns the amount of items in use. */
+extern u32   pool_used(pool *pool);
+
+/* Returns an allocator that takes anything up to the item size from the pool and
+ * anything bigger from the allocator the pool was created with. Memory that fits
+ * an item can't be aligned past the alignment of the items. */
+extern const blib_allocator *pool_allocator(pool *pool);
+
+/* Destroys the pool and all its slabs. */
+extern void  pool_destroy(pool *pool);
+
+/*
+ * *** Region ***
+ * */
+
+/* An arena for a scene: while a region is open every container and entity type
+ * created draws its memory from it, then resetting it frees all of them at once.
+ * Strings aren't affected, small ones live on a pool anyway, but the keys of the
+ * string keyed hash tables created in it come from the region too. */
+typedef struct region region;
+
+/* Creates a region that starts with `capa` bytes, it grows when they run out. */
+extern region *region_create(u64 capa);
+
+/* Opens `region`, it stays open until `region_end`. Regions can be nested. */
+extern void    region_begin(region *region);
+
+/* Closes the open region, the one open before it (if any) is open again. */
+extern void    region_end(void);
+
+/* Destroys the entity types created in the region and frees everything else
+ * allocated from it, the containers created in it can't be used anymore. */
+extern void    region_reset(region *region);
+
+/* Returns the bytes allocated from the region since it was created or reset. */
+extern u64     region_used(region *region);
+
+/* Resets the region then destroys it. */
+extern void    region_destroy(region *region);
+
 /*
  * *** String ***
  * */
@@ -571,8 +740,36 @@ extern void string_copy(str *dest, str src);
  * `dest` must have been created by `string_create()`. */
 extern void string_concat(str *dest, str src);
 
+/* Empties a string keeping its capacity. A string created by `string_create()`
+ * works as a builder: its capacity doubles as it's appended to, and clearing it
+ * every frame builds it again without reallocating. */
+extern void string_clear(str *str);
+
+/* Appends the character `c` to `dest`. */
+extern void string_append_char(str *dest, char c);
+
+/* Appends `value` in decimal to `dest`. */
+extern void string_append_u64(str *dest, u64 value);
+extern void string_append_s64(str *dest, s64 value);
+
+/* Appends `value` to `dest` with `decimals` decimals, rounded half up.
+ * Values too big to be exact with them fall back to printf's "%.*f". */
+extern void string_append_f64(str *dest, f64 value, u32 decimals);
+
+/* Appends the printf style `fmt` formatted with the arguments to `dest`,
+ * it's formatted in place when `dest` has room for it. */
+extern void string_format(str *dest, str fmt, ...);
+extern void string_vformat(str *dest, str fmt, va_list args);
+
+/* Formats `fmt` into memory of `arena`, the string lives until the arena is reset. */
+extern str string_format_arena(arena *arena, str fmt, ...);
+extern str string_vformat_arena(arena *arena, str fmt, va_list args);
+
+/* Formats `fmt` into the frame arena, the string lives during this frame and the next one. */
+extern str frame_format(str fmt, ...);
+
 /* Compares if two strings are equal.
- */
+ * Compares 16 bytes at a time with SSE2, 32 with AVX2. */
 extern b8 string_equal(str s1, str s2);
 
 /* Creates a view into the `src` string from `start` to `end`. */
@@ -591,6 +788,40 @@ extern s8 *string_find_first(str str, s8 c);
 /* Finds the last apperance of the character `c` on `str`. */
 extern s8 *string_find_last(str str, s8 c);
 
+/* Finds the first apperance of `needle` on `haystack`. */
+extern s8 *string_find(str haystack, str needle);
+
+/* Counts the apperances of the character `c` on `str`. */
+extern u32 string_count(str str, s8 c);
+
+/* Moves the part of `src` up to the next `separator` into `part` as a view
+ * and skips `src` past it. Returns false once every part has been taken, so
+ *   while (string_split(&rest, ',', &part)) { ... }
+ * walks all of them, empty ones included. */
+extern b8 string_split(str *src, s8 separator, str *part);
+
+/* Strings hold UTF-8 text, the functions above work on its bytes and the ones
+ * below on its codepoints. Runs of ASCII are skipped 16 bytes at a time. */
+
+/* The codepoint of the malformed sequences, U+FFFD. */
+#define UTF8_INVALID 0xfffd
+
+/* Returns true when `str` is well formed UTF-8: no overlong sequences,
+ * surrogates nor codepoints past U+10FFFF. */
+extern b8 string_utf8_valid(str str);
+
+/* Returns the amount of codepoints of `str`, each malformed byte counts as one. */
+extern u32 string_utf8_length(str str);
+
+/* Decodes the codepoint starting at the byte `*index` of `str` and moves `*index`
+ * past it. A malformed sequence gives UTF8_INVALID and only one byte is skipped.
+ *   for (u32 i = 0; i < text.size;) { u32 codepoint = string_utf8_next(text, &i); ... } */
+extern u32 string_utf8_next(str str, u32 *index);
+
+/* Appends the UTF-8 encoding of `codepoint`, UTF8_INVALID when it isn't one.
+ * `dest` must have been created by `string_create()`. */
+extern void string_append_utf8(str *dest, u32 codepoint);
+
 /* Reverses the contents of a string
  * `str` must have been created by `string_create()`. */
 extern void string_reverse(str str);
@@ -598,15 +829,83 @@ extern void string_reverse(str str);
 /* Destroys strings that've been created by `string_create()`. */
 extern void string_destroy(str str);
 
+/*
+ *
+ * *** Text Buffer ***
+ *
+ * */
+
+/* Editable text for consoles, chat boxes and editors. It's a gap buffer: the free
+ * space follows the edits, so inserting and deleting at the cursor is amortized
+ * O(1) however long the text is, and jumping somewhere else costs the bytes in
+ * between on the next edit. The line breaks are tracked as the text changes,
+ * finding a line never scans the text. Positions and amounts are in bytes. */
+typedef struct text_buffer text_buffer;
+
+/* Creates a text buffer holding a copy of `src`, the cursor at its end. */
+extern text_buffer *text_buffer_create(str src);
+
+/* Returns the size of the text. */
+extern u32  text_buffer_size(text_buffer *text);
+
+/* Returns the position of the cursor. */
+extern u32  text_buffer_cursor(text_buffer *text);
+
+/* Moves the cursor to `index`, clamped to the size of the text. */
+extern void text_buffer_seek(text_buffer *text, u32 index);
+
+/* Inserts `src` at the cursor and moves the cursor past it. */
+extern void text_buffer_insert(text_buffer *text, str src);
+
+/* Inserts the UTF-8 encoding of `codepoint` at the cursor, e.g. a typed char. */
+extern void text_buffer_insert_utf8(text_buffer *text, u32 codepoint);
+
+/* Deletes up to `amount` bytes after the cursor. */
+extern void text_buffer_delete(text_buffer *text, u32 amount);
+
+/* Deletes up to `amount` bytes before the cursor. */
+extern void text_buffer_backspace(text_buffer *text, u32 amount);
+
+/* Empties the text keeping its capacity. */
+extern void text_buffer_clear(text_buffer *text);
+
+/* Places the whole text as two views, `before` followed by `after`, in O(1).
+ * Like the other views they're valid until the next change of the text. */
+extern void text_buffer_parts(text_buffer *text, str *before, str *after);
+
+/* Returns the text as a single view, e.g. for `draw_text()`. It closes the gap
+ * moving the bytes past the last edit, nothing if it was at the end. */
+extern str  text_buffer_str(text_buffer *text);
+
+/* Returns the amount of lines, one more than the line breaks. */
+extern u32  text_buffer_lines(text_buffer *text);
+
+/* Returns where `line` starts. */
+extern u32  text_buffer_line_start(text_buffer *text, u32 line);
+
+/* Returns the line the byte at `index` is on, in O(log lines). */
+extern u32  text_buffer_line_at(text_buffer *text, u32 index);
+
+/* Returns a view of `line` without its line break. If the last edit was in the
+ * middle of the line the bytes after it on the line are moved. */
+extern str  text_buffer_line(text_buffer *text, u32 line);
+
+/* Destroys the text buffer. */
+extern void text_buffer_destroy(text_buffer *text);
+
 /*
  *
  * *** Array List ***
  *
  * */
 
-/* Creates an array list of `type_size` in bytes then return it. */
+/* Creates an array list of `type_size` in bytes then return it.
+ * The items are aligned to BLIB_ALIGN. */
 extern void *array_list_create(u32 type_size);
 
+/* Creates an array list that gets its memory from `allocator` for its whole life. */
+extern void *array_list_create_with(u32 type_size, const blib_allocator *allocator);
+
 /* Get the array list's capacity. */
 extern u32   array_list_capacity(void *arr);
 
@@ -650,12 +949,217 @@ extern void  array_list_pop(void *arr, void *out);
 /* Shrinks the array list's size, removing the item at `index`. Places the deleted value on `out`. */
 extern void  array_list_remove(void *arr, u32 index, void *out);
 
+/* Removes the item at `index` moving the last item into its place, it doesn't keep
+ * the order but it doesn't shift the list. Places the deleted value on `out`. */
+extern void  array_list_swap_remove(void *arr, u32 index, void *out);
+
+/* Removes `amount` items starting on `index`, shifting the rest of the list only once. */
+extern void  array_list_remove_range(void *arr, u32 index, u32 amount);
+
+/* Returns true when `item` must be removed by `array_list_remove_if`. */
+typedef b8 (*array_list_predicate)(void *item, void *ctx);
+
+/* Removes every item for which `remove(item, ctx)` is true in a single pass,
+ * keeping the order. Returns the amount of removed items. */
+extern u32   array_list_remove_if(void *arr, array_list_predicate remove, void *ctx);
+
+/* Removes every item `i` with `keep[i]` false in a single pass, keeping the order.
+ * `keep` has one entry per item. Returns the amount of removed items. */
+extern u32   array_list_keep_mask(void *arr, const b8 *keep);
+
 /* Clears all the content of an array list. */
 extern void array_list_clear(void *arr);
 
 /* Destroys the list. */
 extern void  array_list_destroy(void *arr);
 
+/* Growth statistics of an array list, only collected when blib is built
+ * with BLIB_CONTAINER_STATS, otherwise they're all zero. */
+typedef struct {
+  u32 reallocs;
+  u32 peak_capacity;
+  u64 bytes_copied; /* by reallocations that moved the list */
+} array_list_stats;
+
+/* Returns the growth statistics of an array list. */
+extern array_list_stats array_list_get_stats(void *arr);
+
+/* Prints the growth statistics of an array list, `name` identifies it on the output. */
+extern void array_list_stats_dump(void *arr, ccstr name);
+
+/* The header placed right before the items of every array list. */
+typedef struct {
+  u32 size;
+  u32 capa;
+  u32 type;
+} array_list_header;
+#define ARRAY_LIST_HEADER(ARR) (((array_list_header *)(ARR)) - 1)
+
+/* Generates typed functions named `NAME_*` for array lists of `T`, the sizes are
+ * known at compile time so they get inlined. They work on the same array lists
+ * as the functions above, e.g. `ARRAY_LIST_SETUP(v2f_list, v2f)` then
+ * `positions = v2f_list_push(positions, pos)`.
+ * */
+#define ARRAY_LIST_SETUP(NAME, T)                                                             \
+static inline T *                                                                             \
+NAME ## _create(void) {                                                                       \
+  return array_list_create(sizeof (T));                                                       \
+}                                                                                             \
+                                                                                              \
+static inline u32                                                                             \
+NAME ## _size(T *arr) {                                                                       \
+  return ARRAY_LIST_HEADER(arr)->size;                                                        \
+}                                                                                             \
+                                                                                              \
+static inline T *                                                                             \
+NAME ## _push(T *arr, T item) {                                                               \
+  array_list_header *header = ARRAY_LIST_HEADER(arr);                                         \
+  if (header->size + 1 >= header->capa) {                                                     \
+    arr = array_list_grow(arr, 1);                                                            \
+    arr[ARRAY_LIST_HEADER(arr)->size - 1] = item;                                             \
+    return arr;                                                                               \
+  }                                                                                           \
+  arr[header->size++] = item;                                                                 \
+  return arr;                                                                                 \
+}                                                                                             \
+                                                                                              \
+/* the list can't be empty */                                                                 \
+static inline T                                                                               \
+NAME ## _pop(T *arr) {                                                                        \
+  return arr[--ARRAY_LIST_HEADER(arr)->size];                                                 \
+}                                                                                             \
+                                                                                              \
+/* `index` can't be past the end of the list */                                               \
+static inline T *                                                                             \
+NAME ## _insert(T *arr, u32 index, T item) {                                                  \
+  arr = NAME ## _push(arr, item);                                                             \
+  u32 size = ARRAY_LIST_HEADER(arr)->size;                                                    \
+  memmove(arr + index + 1, arr + index, (size - 1 - index) * sizeof (T));                     \
+  arr[index] = item;                                                                          \
+  return arr;                                                                                 \
+}                                                                                             \
+                                                                                              \
+static inline T                                                                               \
+NAME ## _remove(T *arr, u32 index) {                                                          \
+  array_list_header *header = ARRAY_LIST_HEADER(arr);                                         \
+  T item = arr[index];                                                                        \
+  memmove(arr + index, arr + index + 1, (header->size - index - 1) * sizeof (T));             \
+  header->size--;                                                                             \
+  return item;                                                                                \
+}                                                                                             \
+                                                                                              \
+static inline T                                                                               \
+NAME ## _swap_remove(T *arr, u32 index) {                                                     \
+  array_list_header *header = ARRAY_LIST_HEADER(arr);                                         \
+  T item = arr[index];                                                                        \
+  arr[index] = arr[--header->size];                                                           \
+  return item;                                                                                \
+}                                                                                             \
+                                                                                              \
+/* end ARRAY_LIST_SETUP */
+
+
+/*
+ *
+ * *** Segment List ***
+ *
+ * */
+
+/* A list made of fixed-size segments, growing it never moves the items already
+ * in it, so their addresses stay valid and appends never copy the list. */
+typedef struct segment_list segment_list;
+
+/* Creates a segment list with `segment_capa` items per segment (rounded down to a
+ * power of two, below 2^31), 0 picks segments of about 16 KiB. Returns (NULL) if
+ * `type_size` is 0 or `segment_capa` is too big. */
+extern segment_list *segment_list_create(u32 type_size, u32 segment_capa);
+
+/* Returns the amount of items in the segment list. */
+extern u32   segment_list_size(segment_list *list);
+
+/* Returns the item at `index`, NULL if it's out of bounds. */
+extern void *segment_list_get(segment_list *list, u32 index);
+
+/* Appends a copy of `item` (left uninitialized if NULL) and returns its address,
+ * which stays valid until the item is removed. */
+extern void *segment_list_push(segment_list *list, void *item);
+
+/* Removes the last item. Places the deleted value on `out`. */
+extern void  segment_list_pop(segment_list *list, void *out);
+
+/* Removes the item at `index` moving the last item into its place. Places the
+ * deleted value on `out`. */
+extern void  segment_list_swap_remove(segment_list *list, u32 index, void *out);
+
+/* Returns the amount of segments holding items. */
+extern u32   segment_list_segments(segment_list *list);
+
+/* Returns the items of `segment` as a contiguous array, its size goes on `out_size`.
+ * Iterate segment by segment to walk the list in contiguous runs. */
+extern void *segment_list_segment(segment_list *list, u32 segment, u32 *out_size);
+
+/* Clears all the content of a segment list, keeping its segments for reuse. */
+extern void  segment_list_clear(segment_list *list);
+
+/* Destroys the list. */
+extern void  segment_list_destroy(segment_list *list);
+
+
+/*
+ *
+ * *** Sorting ***
+ *
+ * */
+
+/* Returns a negative value when `a` goes before `b`, positive when it goes after
+ * and zero when they're equal, same as the `qsort` comparators. */
+typedef s32 (*sort_compare)(const void *a, const void *b);
+
+/* The type of the key a radix sort orders the items by. */
+typedef enum {
+  SORT_KEY_U32,
+  SORT_KEY_F32,
+  SORT_KEY_U64
+} sort_key_type;
+
+typedef enum {
+  SORT_DESCENDING = 1 << 0,
+  SORT_PARALLEL   = 1 << 1  /* splits big radix sorts across threads */
+} sort_flags;
+
+/* Sorts `amount` items of `stride` bytes by the key found `key_offset` bytes into
+ * every item. It's a stable LSD radix sort, `flags` is 0 or a mix of `sort_flags`. */
+extern void sort_radix(void *items, u32 amount, u32 stride, u32 key_offset, sort_key_type key, sort_flags flags);
+
+/* Sorts `amount` items of `stride` bytes with `compare` (introsort, not stable). */
+extern void sort_intro(void *items, u32 amount, u32 stride, sort_compare compare);
+
+/* Sorts an array list with `compare`, see `sort_intro`. */
+extern void array_list_sort(void *arr, sort_compare compare);
+
+/* Sorts an array list by the key found `key_offset` bytes into every item, see `sort_radix`.
+ * e.g. `array_list_sort_radix(enemies, offsetof(enemy, distance), SORT_KEY_F32, 0)` */
+extern void array_list_sort_radix(void *arr, u32 key_offset, sort_key_type key, sort_flags flags);
+
+
+/*
+ *
+ * *** Hashing ***
+ *
+ * */
+
+/* Hashes `size` bytes of `data` (XXH64). */
+extern u64 hash_bytes(const void *data, u32 size);
+
+/* Hashes the contents of `s`. */
+extern u64 hash_str(str s);
+
+/* Hashes an integer, every bit of `x` affects every bit of the result. */
+extern u64 hash_u64(u64 x);
+
+/* Hashes a 128 bits integer, every bit of `x` affects every bit of the result. */
+extern u64 hash_u128(u128 x);
+
 /*
  *
  * *** Hash Table ***
@@ -667,19 +1171,47 @@ typedef enum {
   HT_STR = 0,
   HT_U64,
   HT_U128,
+  HT_U32,
+  HT_BYTES, /* fixed size keys compared byte by byte, see `hash_table_create_bytes` */
   HT_AMOUNT
 } hash_table_type;
 
+/* Hashes a `size` bytes key of a HT_BYTES hash table. */
+typedef u64 (*hash_table_hash_func)(const void *key, u32 size);
+
+/* Returns true when two `size` bytes keys of a HT_BYTES hash table are the same. */
+typedef b8 (*hash_table_equal_func)(const void *a, const void *b, u32 size);
+
 /* Creates a hash table. */
 extern hash_table *hash_table_create(u32 type_size, hash_table_type key_type);
 
+/* Creates a hash table that gets its memory from `allocator` for its whole life. */
+extern hash_table *hash_table_create_with(u32 type_size, hash_table_type key_type, const blib_allocator *allocator);
+
+/* Creates a hash table with keys of `key_size` bytes, like structs or vectors.
+ * The keys are stored inline. `hash` defaults to `hash_bytes` and `equal` to
+ * comparing every byte when NULL, so keys with padding need both.
+ * */
+extern hash_table *hash_table_create_bytes(u32 type_size, u32 key_size, hash_table_hash_func hash, hash_table_equal_func equal);
+
+/* Makes room for `amount` keys in total, counting the ones already in it, so
+ * adding keys until there are `amount` won't resize the hash table. */
+extern void hash_table_reserve(hash_table *ht, u32 amount);
+
 /* Returns a pointer to the value located at the `key` of a hash table.
  * In case the `key` doesn't exists returns NULL.
  * */
 extern void *hash_table_get(hash_table *ht, void *key);
 
+/* Looks up `amount` keys at once, `keys` is an array of them. `out_vals[i]` is
+ * set to the value of `keys[i]` or NULL, same as `hash_table_get`, it's faster
+ * for many keys since their memory accesses are overlapped.
+ * */
+extern void hash_table_get_batch(hash_table *ht, const void *keys, u32 amount, void **out_vals);
+
 /* Sets `out_key` pointer value to the key of the pointer to a value.
- * `val` is a pointer returned by `hash_table_get` or `hash_table_add`
+ * `val` is a pointer returned by `hash_table_get` or `hash_table_add`.
+ * Tables created with a `type_size` of 0 have no values to find the key by.
  * */
 extern void hash_table_value_key(hash_table *ht, void *val, void *out_key);
 
@@ -695,6 +1227,84 @@ extern void hash_table_clear(hash_table *ht);
 /* Destroys a hash table. */
 extern void hash_table_destroy(hash_table *ht);
 
+/* Buckets of the probe length histogram, the last one counts every longer probe. */
+#define HASH_TABLE_STATS_PROBES 16
+
+/* Statistics of a hash table. The size, capacity and tombstones are always
+ * there, the rest is only collected when blib is built with
+ * BLIB_CONTAINER_STATS, otherwise it's all zero. */
+typedef struct {
+  u32 size;
+  u32 capacity;
+  u32 tombstones;
+  u32 resizes;
+  f64 resize_time; /* in seconds */
+  u64 lookups;
+  u64 probes[HASH_TABLE_STATS_PROBES]; /* `probes[i]` lookups probed `i + 1` groups */
+  u32 max_probe;
+} hash_table_stats;
+
+/* Returns the statistics of a hash table. */
+extern hash_table_stats hash_table_get_stats(hash_table *ht);
+
+/* Prints the statistics of a hash table, `name` identifies it on the output. */
+extern void hash_table_stats_dump(hash_table *ht, ccstr name);
+
+/* Typed hash tables are generated by HASH_TABLE_SETUP: include <blib_internal.h>
+ * after this file, it has the macro along with the layout of the table its
+ * functions are inlined against (see "Typed hash tables" in the README). */
+
+/*
+ *
+ * *** Atoms ***
+ *
+ * */
+
+/* An interned string. Every different string gets its own atom and keeps it,
+ * so names can be compared and used as keys like integers. */
+typedef u32 atom;
+#define ATOM_NONE 0
+
+/* Returns the atom of `s`, interning a copy of it the first time. */
+extern atom atom_intern(str s);
+
+/* Same as `atom_intern` for a string whose `atom_hash_str` is already known. */
+extern atom atom_intern_hashed(str s, u64 hash);
+
+/* Returns the atom of `s` or ATOM_NONE when it was never interned, it never allocates. */
+extern atom atom_find(str s);
+
+/* Returns the string of an atom, it's NUL terminated and lives until the program ends. */
+extern str atom_str(atom a);
+
+/* Returns the hash of the string of an atom without hashing it again. */
+extern u64 atom_hash(atom a);
+
+/* Hashes a string the way atoms do (FNV-1a). */
+extern u64 atom_hash_str(str s);
+
+/* Hashes a string literal like `atom_hash_str`. Literals of up to ATOM_HASH_MAX
+ * chars are hashed by the compiler when optimizing, longer ones at run time. */
+#define ATOM_HASH_MAX 32
+#define ATOM_HASH(S) (sizeof (S) - 1 <= ATOM_HASH_MAX ? ATOM_HASH_32(S) : atom_hash_str(STR(S)))
+
+/* Interns a string literal without hashing it at run time, e.g.
+ * `static atom position; position = ATOM("position");` */
+#define ATOM(S) atom_intern_hashed(STR(S), ATOM_HASH(S))
+
+/* every step only uses the hash once, so the expansion grows linearly */
+#define ATOM_HASH_OFFSET UINT64_C(0xcbf29ce484222325)
+#define ATOM_HASH_PRIME  UINT64_C(0x100000001b3)
+#define ATOM_HASH_STEP(S, I, H) \
+  (((H) ^ ((I) < sizeof (S) - 1 ? (u8)(S)[(I) < sizeof (S) - 1 ? (I) : 0] : 0)) * \
+   ((I) < sizeof (S) - 1 ? ATOM_HASH_PRIME : 1))
+#define ATOM_HASH_4(S, I, H) \
+  ATOM_HASH_STEP(S, (I) + 3, ATOM_HASH_STEP(S, (I) + 2, ATOM_HASH_STEP(S, (I) + 1, ATOM_HASH_STEP(S, I, H))))
+#define ATOM_HASH_32(S) \
+  ATOM_HASH_4(S, 28, ATOM_HASH_4(S, 24, ATOM_HASH_4(S, 20, ATOM_HASH_4(S, 16, \
+  ATOM_HASH_4(S, 12, ATOM_HASH_4(S,  8, ATOM_HASH_4(S,  4, ATOM_HASH_4(S,  0, ATOM_HASH_OFFSET))))))))
+
+
 /*
  * ****************************
  * ****************************
@@ -707,17 +1317,28 @@ extern void hash_table_destroy(hash_table *ht);
  * *** Entity System ***
  */
 
+/* The id of an entity type, it stays the same until the type is destroyed.
+ * The ids of destroyed types stay invalid, even after their slot is reused. */
+typedef u32 entity_type_id;
+#define ENTITY_TYPE_NONE ((entity_type_id)-1)
+
+/* The id of a component of an entity type, its index on the components of the type
+ * in the order they were added. The same component on two types may have two ids. */
+typedef u32 component_id;
+#define COMPONENT_NONE ((component_id)-1)
+
 /* A game entity struct. */
 typedef struct {
-  u32 type;
+  atom type;              /* the atom of its type name */
+  entity_type_id type_id;
   u128 id;
 } entity;
 
-/* Begin the creation of a entity type. */
-extern void entity_type_begin(str name);
+/* Begin the creation of a entity type then return its id, ENTITY_TYPE_NONE if it can't be created. */
+extern entity_type_id entity_type_begin(str name);
 
 /* Adds a component to the current entity type being created then return the component id. */
-extern void entity_type_add_component(str name, u32 size);
+extern component_id entity_type_add_component(str name, u32 size);
 
 /* End the creation of a entity type */
 extern void entity_type_end(void);
@@ -728,6 +1349,16 @@ extern void *entity_type_get_components(str type_name, str comp_name);
 /* All the entities will be destroyed. */
 extern void entity_type_clear(str name);
 
+/* Destroys an entity type, its entities and its components. */
+extern void entity_type_destroy(str name);
+
+/* Makes room for `amount` entities of a type, creating them won't reallocate. */
+extern void entity_type_reserve(str name, u32 amount);
+
+/* Reorders the entities of a type by the key found `key_offset` bytes into the
+ * component `comp_name`, see `sort_radix`. Their ids stay valid. */
+extern void entity_type_sort(str type_name, str comp_name, u32 key_offset, sort_key_type key, sort_flags flags);
+
 /* Creates a new entity of the specified type and puts into `e` */
 extern void entity_create(str type_name, entity *e);
 
@@ -740,6 +1371,30 @@ extern void entity_destroy_by_index(str type_name, u32 index);
 /* Destroys an entity. */
 extern void entity_destroy(entity *e);
 
+/* The same as the functions above with the atoms of the names, they look them
+ * up without hashing nor comparing any string, e.g. with `position = ATOM("position")`
+ * kept since `__init`, `entity_get_component_atom(&e, position)`. */
+extern void  entity_create_atom(atom type_name, entity *e);
+extern void *entity_get_component_atom(entity *e, atom comp_name);
+extern void *entity_type_get_components_atom(atom type_name, atom comp_name);
+extern void  entity_destroy_by_index_atom(atom type_name, u32 index);
+
+/* Returns the id of the entity type `name`, ENTITY_TYPE_NONE if it doesn't exist. */
+extern entity_type_id entity_type_find(str name);
+
+/* Returns the id of the component `name` of a type, COMPONENT_NONE if it doesn't have it. */
+extern component_id entity_type_find_component(entity_type_id type, str name);
+
+/* The same as the functions above with the ids returned when the type was created,
+ * they find the type and the component column by indexing, only the entity is
+ * looked up. `comp` must be an id of the type of the entity, e.g. with the ids kept
+ *   position = entity_type_add_component(STR("position"), sizeof (v2f));
+ * `entity_get_component_id(&e, position)`. */
+extern void  entity_create_id(entity_type_id type, entity *e);
+extern void *entity_get_component_id(entity *e, component_id comp);
+extern void *entity_type_get_components_id(entity_type_id type, component_id comp);
+extern void  entity_destroy_by_index_id(entity_type_id type, u32 index);
+
 /*
  * *** Asset Manager
  */
@@ -764,8 +1419,9 @@ typedef enum {
  *       jpg/jpeg
  *    Sprite Fonts:
  *     All sprite fonts must be placed inside 'assets/spritefonts/'.
- *     Sprite fonts only supports full ascii in a row for now
- *     (look 'assets/spritefonts/default.png' for an example)
+ *     Sprite fonts have full ascii in a row
+ *     (look 'assets/spritefonts/default.png' for an example),
+ *     more rows and codepoints are mapped with `sprite_font_map()`
  *     supported sprite fonts formats:
  *       png
  *       tga
@@ -904,6 +1560,16 @@ extern void sprite_font_setup(str font, u32 char_width, u32 char_height, u32 pad
 /* Gets the `font` texture id. */
 extern texture_id sprite_font_get_id(str font);
 
+/* Maps `amount` codepoints starting at `first` to the glyphs of `font` starting at
+ * `glyph`. Glyphs are numbered left to right and top to bottom from the top left
+ * one, on rows as wide as the texture. By default '!' to '~' are the glyphs 0 to 93
+ * and the rest is 94. `sprite_font_setup` brings the default back, so map after it.
+ * e.g. `sprite_font_map(STR("font"), 0x410, 64, 95)` for cyrillic after ASCII. */
+extern void sprite_font_map(str font, u32 first, u32 amount, u32 glyph);
+
+/* Sets the glyph of the codepoints `font` doesn't map. */
+extern void sprite_font_map_unknown(str font, u32 glyph);
+
 /*
  * *** Texture Buffer
  */
@@ -1020,7 +1686,8 @@ extern void draw_line(v2f p1, v2f p2, f32 thickness, v4f blend, u32 layer);
 /* Draws a tile of the current batch texture. */
 extern void draw_tile(v2u tile, v2f position, v2f scale, v2f pivot, f32 angle, v4f blend, u32 layer);
 
-/* Draws a text into the screen, the text must have 512 characters only. */
+/* Draws a text into the screen, it's formatted on the frame arena. The text is
+ * UTF-8, the codepoints past ASCII are drawn as mapped by `sprite_font_map`. */
 extern void draw_text(v2f position, v2f scale, v4f blend, u32 layer, str fmt, ...);
 
 /* Draws a part of the current batch texture buffer.
@@ -1029,6 +1696,11 @@ extern void draw_text(v2f position, v2f scale, v4f blend, u32 layer, str fmt, ..
  * */
 extern void draw_texture_buff(v2f position, v2f size, v2f pivot, f32 angle, v4f blend, u32 layer, v2f *parts);
 
+/* Draws the quads of `layer` from the highest to the lowest y when enabled, so the
+ * lower ones end up in front. The order is kept between equal ys and it only
+ * applies within each shader of the layer. */
+extern void layer_sort_by_y(u32 layer, b8 enable);
+
 /*
  * *** Input ***
  */
@@ -1118,6 +1790,10 @@ typedef struct {
   u32  quads_capacity;
   u32  layers_amount;
   u32  ticks_per_second;
+  b8   frame_stats; /* reports frame time percentiles on exit, same as `--frame-stats` */
+  const blib_allocator *allocator; /* the allocator of the library, NULL for `blib_default_allocator` */
+  u64  frame_arena_size; /* bytes of each of the two frame arenas, they grow if it isn't enough */
+  u32  memory_warmup_frames; /* frames allowed to allocate in the main loop before BLIB_MEMORY_STATS warns */
 } blib_config;
 
 #endif/*__BLIB_H__*/
@@ -0,0 +1,255 @@
+#ifndef __BLIB_INTERNAL_H__
+#define __BLIB_INTERNAL_H__
+
+/*
+ * The internals of blib that its typed containers are inlined against. blib.h
+ * keeps the hash table opaque, games that want typed hash tables include this
+ * file after blib.h and use HASH_TABLE_SETUP (see the README). Everything here
+ * depends on the layout of the table and on SSE2 when it's available, so code
+ * using it has to be rebuilt along with blib.
+ * */
+
+#include "blib.h"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+/*
+ *
+ * *** Hash Table ***
+ *
+ * */
+
+typedef union {
+  void *ptr;
+  str *str;
+  u64 *u64;
+  u128 *u128;
+  u32 *u32;
+  u8 *bytes;
+} hash_table_key;
+
+/*
+ * The hash table is an open addressing table probed in groups of
+ * HASH_TABLE_GROUP slots. Every slot has a control byte: the 7 low bits
+ * of the key hash when the slot is full, HASH_TABLE_EMPTY or
+ * HASH_TABLE_DELETED otherwise, so a whole group can be compared against
+ * a hash with a single SSE2 compare, only touching the keys on a match.
+ * The low 32 bits of every key hash are kept too, so keys are only
+ * compared on a full hash match and growing never rehashes the keys.
+ * The capacity is always a power of two multiple of the group size.
+ */
+struct hash_table {
+  hash_table_type       key_type;
+  u32                   key_size;
+  hash_table_hash_func  key_hash;
+  hash_table_equal_func key_equal;
+  hash_table_key        keys;
+  u8                   *ctrl;
+  u32                  *hashes;
+  u8                   *vals;
+  void                 *buff;
+  u32                   type;
+  u32                   capa;
+  u32                   size;
+  u32                   deleted;
+  const blib_allocator *allocator;
+  memory_tag            tag;
+  /* only blib.c touches the stats, they're last so the layout of
+   * everything else doesn't depend on BLIB_CONTAINER_STATS */
+#ifdef BLIB_CONTAINER_STATS
+  hash_table_stats      stats;
+#endif
+};
+
+#define HASH_TABLE_GROUP   16
+#define HASH_TABLE_EMPTY   0x80
+#define HASH_TABLE_DELETED 0xfe
+#define HASH_TABLE_NONE    ((u32)-1)
+
+#define HASH_TABLE_H1(HASH) ((HASH) >> 7)
+#define HASH_TABLE_H2(HASH) ((u8)((HASH) & 0x7f))
+
+/* The table grows when full and deleted slots reach 7/8 of the capacity. */
+#define HASH_TABLE_MAX_LOAD(CAPA) ((CAPA) - (CAPA) / 8)
+
+#ifdef __GNUC__
+#define CTZ32(X) ((u32)__builtin_ctz(X))
+#else
+static inline u32
+CTZ32(u32 x) {
+  u32 n = 0;
+  while (!(x & 1)) { x >>= 1; n++; }
+  return n;
+}
+#endif
+
+/* Each of these returns a bitmask with the bit `i` set when the slot `i` of the group matches. */
+#ifdef __SSE2__
+static inline u32
+hash_table_group_match(const u8 *group, u8 h2) {
+  __m128i ctrl = _mm_loadu_si128((const __m128i *)group);
+  return _mm_movemask_epi8(_mm_cmpeq_epi8(ctrl, _mm_set1_epi8((s8)h2)));
+}
+
+static inline u32
+hash_table_group_match_empty(const u8 *group) {
+  __m128i ctrl = _mm_loadu_si128((const __m128i *)group);
+  return _mm_movemask_epi8(_mm_cmpeq_epi8(ctrl, _mm_set1_epi8((s8)HASH_TABLE_EMPTY)));
+}
+
+/* empty and deleted are the only control bytes with the high bit set */
+static inline u32
+hash_table_group_match_free(const u8 *group) {
+  return _mm_movemask_epi8(_mm_loadu_si128((const __m128i *)group));
+}
+#else
+static inline u32
+hash_table_group_match(const u8 *group, u8 h2) {
+  u32 mask = 0;
+  for (u32 i = 0; i < HASH_TABLE_GROUP; i++) mask |= (u32)(group[i] == h2) << i;
+  return mask;
+}
+
+static inline u32
+hash_table_group_match_empty(const u8 *group) {
+  return hash_table_group_match(group, HASH_TABLE_EMPTY);
+}
+
+static inline u32
+hash_table_group_match_free(const u8 *group) {
+  u32 mask = 0;
+  for (u32 i = 0; i < HASH_TABLE_GROUP; i++) mask |= (u32)(group[i] >> 7) << i;
+  return mask;
+}
+#endif
+
+/* Returns the first empty or deleted slot of the probe sequence of `hash`. */
+static inline u32
+hash_table_find_free(hash_table *ht, u32 hash) {
+  u32 groups_mask = ht->capa / HASH_TABLE_GROUP - 1;
+  u32 group = HASH_TABLE_H1(hash) & groups_mask;
+  for (u32 probe = 0;; probe++) {
+    u32 match = hash_table_group_match_free(ht->ctrl + group * HASH_TABLE_GROUP);
+    if (match) return group * HASH_TABLE_GROUP + CTZ32(match);
+    group = (group + probe + 1) & groups_mask;
+  }
+}
+
+/* Makes room for one more key, called when adding it would pass HASH_TABLE_MAX_LOAD.
+ * Every slot moves, so the indexes found before are stale. */
+extern void hash_table_grow(hash_table *ht);
+
+/* Equality for HASH_TABLE_SETUP keys that can be compared with `==`. */
+#define HASH_TABLE_EQUAL(A, B) ((A) == (B))
+
+/* Generates typed functions named `NAME_*` for hash tables with keys of type `K`
+ * and values of type `V`. `HASH(key)` returns the u64 hash of a key and
+ * `EQUAL(a, b)` compares two keys, both can be functions or macros. The tables are
+ * HT_BYTES hash tables so every `hash_table_*` function works on them, but the
+ * probes of `NAME_get`, `NAME_add` and `NAME_del` get inlined with the key size,
+ * hash and compare known at compile time. Only the cold paths (growing, warning
+ * about a duplicated or missing key) go through blib.c, and the probes of the
+ * typed functions aren't counted by the container stats.
+ * e.g. `HASH_TABLE_SETUP(tile_table, u32, v2u, hash_u64, HASH_TABLE_EQUAL)`
+ * */
+#define HASH_TABLE_SETUP(NAME, K, V, HASH, EQUAL)                                             \
+static inline u64                                                                             \
+NAME ## _hash_key(const void *key, u32 size) {                                                \
+  (void)size;                                                                                 \
+  return HASH(*(const K *)key);                                                               \
+}                                                                                             \
+                                                                                              \
+static inline b8                                                                              \
+NAME ## _equal_key(const void *a, const void *b, u32 size) {                                  \
+  (void)size;                                                                                 \
+  return EQUAL(*(const K *)a, *(const K *)b);                                                 \
+}                                                                                             \
+                                                                                              \
+static inline hash_table *                                                                    \
+NAME ## _create(void) {                                                                       \
+  return hash_table_create_bytes(sizeof (V), sizeof (K),                                      \
+      NAME ## _hash_key, NAME ## _equal_key);                                                 \
+}                                                                                             \
+                                                                                              \
+/* Returns the index of `key` or HASH_TABLE_NONE, the same probe as hash_table_find. */       \
+static inline u32                                                                             \
+NAME ## _find(hash_table *ht, K key, u32 hash) {                                              \
+  u32 groups_mask = ht->capa / HASH_TABLE_GROUP - 1;                                          \
+  u32 group       = HASH_TABLE_H1(hash) & groups_mask;                                        \
+  for (u32 probe = 0; probe <= groups_mask; probe++) {                                        \
+    const u8 *ctrl = ht->ctrl + group * HASH_TABLE_GROUP;                                     \
+    u32 match = hash_table_group_match(ctrl, HASH_TABLE_H2(hash));                            \
+    for (; match; match &= match - 1) {                                                       \
+      u32 index = group * HASH_TABLE_GROUP + CTZ32(match);                                    \
+      if (ht->hashes[index] == hash && EQUAL(((K *)ht->keys.ptr)[index], key)) return index;  \
+    }                                                                                         \
+    if (hash_table_group_match_empty(ctrl)) return HASH_TABLE_NONE;                           \
+    group = (group + probe + 1) & groups_mask;                                                \
+  }                                                                                           \
+  return HASH_TABLE_NONE;                                                                     \
+}                                                                                             \
+                                                                                              \
+static inline V *                                                                             \
+NAME ## _get(hash_table *ht, K key) {                                                         \
+  u32 index = NAME ## _find(ht, key, (u32)HASH(key));                                         \
+  return index == HASH_TABLE_NONE ? 0 : (V *)ht->vals + index;                                \
+}                                                                                             \
+                                                                                              \
+/* The probe for a duplicate also finds the first free slot, the one                          \
+ * hash_table_find_free would return, unless the table has to grow first. */                  \
+static inline V *                                                                             \
+NAME ## _add(hash_table *ht, K key) {                                                         \
+  u32 hash        = (u32)HASH(key);                                                           \
+  u32 groups_mask = ht->capa / HASH_TABLE_GROUP - 1;                                          \
+  u32 group       = HASH_TABLE_H1(hash) & groups_mask;                                        \
+  u32 slot        = HASH_TABLE_NONE;                                                          \
+  for (u32 probe = 0; probe <= groups_mask; probe++) {                                        \
+    const u8 *ctrl = ht->ctrl + group * HASH_TABLE_GROUP;                                     \
+    u32 match = hash_table_group_match(ctrl, HASH_TABLE_H2(hash));                            \
+    for (; match; match &= match - 1) {                                                       \
+      u32 index = group * HASH_TABLE_GROUP + CTZ32(match);                                    \
+      if (ht->hashes[index] == hash && EQUAL(((K *)ht->keys.ptr)[index], key)) {              \
+        return hash_table_add(ht, &key); /* warns about the duplicated key */                 \
+      }                                                                                       \
+    }                                                                                         \
+    u32 free_mask = hash_table_group_match_free(ctrl);                                        \
+    if (slot == HASH_TABLE_NONE && free_mask) {                                               \
+      slot = group * HASH_TABLE_GROUP + CTZ32(free_mask);                                     \
+    }                                                                                         \
+    if (hash_table_group_match_empty(ctrl)) break;                                            \
+    group = (group + probe + 1) & groups_mask;                                                \
+  }                                                                                           \
+  if (ht->size + ht->deleted + 1 > HASH_TABLE_MAX_LOAD(ht->capa)) {                           \
+    hash_table_grow(ht);                                                                      \
+    slot = hash_table_find_free(ht, hash);                                                    \
+  }                                                                                           \
+  if (ht->ctrl[slot] == HASH_TABLE_DELETED) ht->deleted--;                                    \
+  ht->ctrl[slot]            = HASH_TABLE_H2(hash);                                            \
+  ht->hashes[slot]          = hash;                                                           \
+  ((K *)ht->keys.ptr)[slot] = key;                                                            \
+  ht->size++;                                                                                 \
+  return (V *)ht->vals + slot;                                                                \
+}                                                                                             \
+                                                                                              \
+static inline void                                                                            \
+NAME ## _del(hash_table *ht, K key) {                                                         \
+  u32 index = NAME ## _find(ht, key, (u32)HASH(key));                                         \
+  if (index == HASH_TABLE_NONE) {                                                             \
+    hash_table_del(ht, &key); /* warns about the missing key */                               \
+    return;                                                                                   \
+  }                                                                                           \
+  /* same as hash_table_del, a group with an empty slot needs no tombstone */                 \
+  if (hash_table_group_match_empty(ht->ctrl + index / HASH_TABLE_GROUP * HASH_TABLE_GROUP)) { \
+    ht->ctrl[index] = HASH_TABLE_EMPTY;                                                       \
+  } else {                                                                                    \
+    ht->ctrl[index] = HASH_TABLE_DELETED;                                                     \
+    ht->deleted++;                                                                            \
+  }                                                                                           \
+  ht->size--;                                                                                 \
+}                                                                                             \
+                                                                                              \
+/* end HASH_TABLE_SETUP */
+
+#endif/*__BLIB_INTERNAL_H__*/